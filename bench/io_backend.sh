@@ -0,0 +1,34 @@
+#!/bin/sh
+# Compares the sync and io_uring backends on a cold page cache.
+# Needs root to drop the caches, run from the root of a tree:
+#   sudo ./bench/io_backend.sh path/to/cmakegen [runs]
+set -e
+
+CMAKEGEN=${1:?usage: io_backend.sh path/to/cmakegen [runs]}
+RUNS=${2:-5}
+
+if [ "$(id -u)" -ne 0 ]; then
+  echo "io_backend.sh must run as root to drop the page cache" >&2
+  exit 1
+fi
+
+run() {
+  sync
+  echo 3 > /proc/sys/vm/drop_caches
+  start=$(date +%s%N)
+  # --dry-run times the walk and update without writing the CMakeLists.txt files or building
+  "$CMAKEGEN" -b --dry-run --io "$1" > /dev/null 2>&1 || true
+  end=$(date +%s%N)
+  echo $(( (end - start) / 1000000 ))
+}
+
+for backend in sync uring; do
+  total=0
+  i=0
+  while [ "$i" -lt "$RUNS" ]; do
+    elapsed=$(run "$backend")
+    total=$((total + elapsed))
+    i=$((i + 1))
+  done
+  echo "$backend: $((total / RUNS)) ms average over $RUNS cold runs"
+done
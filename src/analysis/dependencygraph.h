@@ -0,0 +1,66 @@
+#ifndef ANALYSIS_DEPENDENCYGRAPH_H
+#define ANALYSIS_DEPENDENCYGRAPH_H
+#include <string>
+#include <vector>
+
+#include "../projectmodel.h"
+
+class ThreadPool;
+
+namespace file_utils {
+class BatchIo;
+}
+
+namespace analysis {
+
+class IncludeScanner;
+
+// What a project needs from the others according to its includes. Libraries are linked PUBLIC when
+// the project's exported headers include theirs, include directories are relative to the project and
+// PUBLIC when another project or an exported header finds headers through them. Exported headers are
+// the ones other projects reach through their includes, all of them for a library no other project includes.
+struct ProjectDependencies {
+  std::vector<std::string> publicLibraries;
+  std::vector<std::string> privateLibraries;
+  std::vector<std::string> publicIncludeDirectories;
+  std::vector<std::string> privateIncludeDirectories;
+};
+
+// A target whose include search path got shorter by keeping private headers' directories private.
+struct SearchPathSaving {
+  std::string target;
+  size_t kept;
+  size_t removed;
+};
+
+struct DependencyReport {
+  std::vector<std::string> describe() const;
+
+  // in the order of the projects given
+  std::vector<ProjectDependencies> projects;
+  // targets that end up depending on themselves, one list per strongly connected group
+  std::vector<std::vector<std::string>> cycles;
+  size_t includes = 0;
+  size_t resolved = 0;
+  size_t ambiguous = 0;
+  size_t redundantLinks = 0;
+  size_t filesRead = 0;
+  size_t filesCached = 0;
+  size_t filesFailed = 0;
+  // the directories on the search paths of all targets, and the targets that lost some compared to every header being public
+  size_t searchDirectories = 0;
+  std::vector<SearchPathSaving> searchPaths;
+};
+
+// Maps every include of the projects' files to the project owning the header through a HeaderIndex.
+// Links that a PUBLIC link already brings along transitively are left out.
+DependencyReport inferDependencies(
+  const std::vector<ProjectModel>& projects,
+  IncludeScanner& scanner,
+  file_utils::BatchIo& io,
+  const ThreadPool& pool
+);
+
+}
+
+#endif
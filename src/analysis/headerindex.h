@@ -0,0 +1,47 @@
+#ifndef ANALYSIS_HEADERINDEX_H
+#define ANALYSIS_HEADERINDEX_H
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../projectmodel.h"
+
+namespace analysis {
+
+struct Include;
+
+// Finds the project header an include refers to. A quoted include is first looked up next to the
+// including file, otherwise the header whose path ends in the include name is used, preferring the
+// including project and skipping names several projects could own.
+class HeaderIndex {
+public:
+  struct Match {
+    size_t project;
+    const std::string* path;
+    // found next to the including file, no include directory is needed for it
+    bool relative;
+  };
+
+  enum Result { Found, NotFound, Ambiguous };
+
+  // The projects have to outlive the index.
+  explicit HeaderIndex(const std::vector<ProjectModel>& projects);
+
+  Result resolve(const std::string& includingFile, size_t project, const Include& include, Match& match) const;
+
+  // The directory the header was found through, relative to the project owning it, empty when it lies outside of it.
+  std::string includeDirectory(const Match& match, const Include& include) const;
+
+private:
+  const std::vector<ProjectModel>& projects_;
+  std::unordered_map<std::string_view, Match> headers_;
+  std::unordered_map<std::string_view, std::vector<Match>> suffixes_;
+};
+
+// Resolves . and .. in a root relative path, an empty result means it left the root.
+std::string normalizePath(std::string_view path);
+
+}
+
+#endif
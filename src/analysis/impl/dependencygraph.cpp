@@ -0,0 +1,354 @@
+#include "../dependencygraph.h"
+#include "../headerindex.h"
+#include "../includescanner.h"
+#include "../../file_utils/batchio.h"
+#include "../../threadpool.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+namespace analysis {
+namespace {
+  const size_t NoProject = static_cast<size_t>(-1);
+
+  // What one project picked up from its includes before they're turned into lists.
+  struct Usage {
+    std::map<size_t, bool> libraries;
+    std::set<std::string> publicDirectories;
+    std::set<std::string> privateDirectories;
+  };
+
+  // Tarjan's algorithm, every group of more than one project is a cycle.
+  std::vector<std::vector<size_t>> findCycles(const std::vector<Usage>& usages) {
+    const auto count = usages.size();
+    std::vector<size_t> index(count, NoProject);
+    std::vector<size_t> lowLink(count, 0);
+    std::vector<char> onStack(count, 0);
+    std::vector<size_t> stack = {};
+    std::vector<std::vector<size_t>> cycles = {};
+    size_t nextIndex = 0;
+
+    std::function<void(size_t)> connect = [&](size_t project) {
+      index[project] = lowLink[project] = nextIndex++;
+      stack.push_back(project);
+      onStack[project] = 1;
+      for (const auto& library : usages[project].libraries) {
+        const auto next = library.first;
+        if (index[next] == NoProject) {
+          connect(next);
+          lowLink[project] = std::min(lowLink[project], lowLink[next]);
+        } else if (onStack[next]) {
+          lowLink[project] = std::min(lowLink[project], index[next]);
+        }
+      }
+
+      if (lowLink[project] == index[project]) {
+        std::vector<size_t> group = {};
+        size_t member = NoProject;
+        do {
+          member = stack.back();
+          stack.pop_back();
+          onStack[member] = 0;
+          group.push_back(member);
+        } while (member != project);
+        if (group.size() > 1) {
+          cycles.push_back(group);
+        }
+      }
+    };
+
+    for (size_t project = 0; project < count; project++) {
+      if (index[project] == NoProject) {
+        connect(project);
+      }
+    }
+    return cycles;
+  }
+
+  // An include resolved to a header of a project, the header is an index into the files when it is one of them.
+  struct ResolvedInclude {
+    size_t owner;
+    size_t header;
+    std::string directory;
+  };
+
+  // The headers the other projects can reach: the ones they include and, through the owner's own
+  // includes, the headers those include. A library none of the others includes keeps all of its
+  // headers exported, it is used from outside the tree.
+  std::vector<char> exportedHeaders(
+    const std::vector<ProjectModel>& projects,
+    const std::vector<size_t>& fileProjects,
+    const std::vector<char>& fileIsHeader,
+    const std::vector<std::vector<ResolvedInclude>>& resolved
+  ) {
+    std::vector<char> exported(resolved.size(), 0);
+    std::vector<char> included(projects.size(), 0);
+    std::vector<size_t> pending = {};
+    for (size_t file = 0; file < resolved.size(); file++) {
+      for (const auto& include : resolved[file]) {
+        if (include.owner != fileProjects[file] && include.header != NoProject && !exported[include.header]) {
+          exported[include.header] = 1;
+          included[include.owner] = 1;
+          pending.push_back(include.header);
+        }
+      }
+    }
+    for (size_t file = 0; file < resolved.size(); file++) {
+      if (fileIsHeader[file] && !included[fileProjects[file]] && !exported[file]) {
+        exported[file] = 1;
+        pending.push_back(file);
+      }
+    }
+
+    while (!pending.empty()) {
+      const auto header = pending.back();
+      pending.pop_back();
+      for (const auto& include : resolved[header]) {
+        if (include.owner == fileProjects[header] && include.header != NoProject && !exported[include.header]) {
+          exported[include.header] = 1;
+          pending.push_back(include.header);
+        }
+      }
+    }
+    return exported;
+  }
+
+  // Links and include directories of every project, an include counts as public when the file holding it is.
+  std::vector<Usage> collectUsages(
+    size_t projectCount,
+    const std::vector<size_t>& fileProjects,
+    const std::vector<char>& filePublic,
+    const std::vector<std::vector<ResolvedInclude>>& resolved
+  ) {
+    std::vector<Usage> usages(projectCount);
+    for (size_t file = 0; file < resolved.size(); file++) {
+      const auto project = fileProjects[file];
+      const bool isPublic = filePublic[file];
+      for (const auto& include : resolved[file]) {
+        const auto owner = include.owner;
+        if (owner == project) {
+          if (!include.directory.empty()) {
+            (isPublic ? usages[owner].publicDirectories : usages[owner].privateDirectories).insert(include.directory);
+          }
+          continue;
+        }
+
+        if (!include.directory.empty()) {
+          usages[owner].publicDirectories.insert(include.directory);
+        }
+        auto& visibility = usages[project].libraries[owner];
+        visibility = visibility || isPublic;
+      }
+    }
+    return usages;
+  }
+
+  // The libraries every project hands on to everything linking it, cycles are cut where they close.
+  std::vector<std::set<size_t>> publicClosures(const std::vector<Usage>& usages) {
+    std::vector<std::set<size_t>> closures(usages.size());
+    std::vector<char> state(usages.size(), 0);
+    std::function<void(size_t)> close = [&](size_t project) {
+      state[project] = 1;
+      for (const auto& library : usages[project].libraries) {
+        if (library.second) {
+          closures[project].insert(library.first);
+          if (state[library.first] == 0) {
+            close(library.first);
+          }
+          if (state[library.first] == 2) {
+            closures[project].insert(closures[library.first].begin(), closures[library.first].end());
+          }
+        }
+      }
+      state[project] = 2;
+    };
+    for (size_t project = 0; project < usages.size(); project++) {
+      if (state[project] == 0) {
+        close(project);
+      }
+    }
+    return closures;
+  }
+
+  // The directories on a project's include search path, its own and the public ones of everything it links.
+  size_t searchDirectoryCount(const std::vector<Usage>& usages, const std::vector<std::set<size_t>>& closures, size_t project) {
+    std::set<size_t> linked = {};
+    for (const auto& library : usages[project].libraries) {
+      linked.insert(library.first);
+      linked.insert(closures[library.first].begin(), closures[library.first].end());
+    }
+    linked.erase(project);
+
+    std::set<std::string> own = usages[project].publicDirectories;
+    own.insert(usages[project].privateDirectories.begin(), usages[project].privateDirectories.end());
+    size_t count = own.size();
+    for (const auto library : linked) {
+      count += usages[library].publicDirectories.size();
+    }
+    return count;
+  }
+}
+
+DependencyReport inferDependencies(
+  const std::vector<ProjectModel>& projects,
+  IncludeScanner& scanner,
+  file_utils::BatchIo& io,
+  const ThreadPool& pool
+) {
+  DependencyReport report;
+
+  std::vector<std::string> files = {};
+  std::vector<size_t> fileProjects = {};
+  std::vector<char> fileIsHeader = {};
+  for (size_t i = 0; i < projects.size(); i++) {
+    for (const auto& includeFile : projects[i].includeFiles) {
+      files.push_back(includeFile);
+      fileProjects.push_back(i);
+      fileIsHeader.push_back(1);
+    }
+    for (const auto& sourceFile : projects[i].sourceFiles) {
+      files.push_back(sourceFile);
+      fileProjects.push_back(i);
+      fileIsHeader.push_back(0);
+    }
+  }
+
+  const auto includes = scanner.scan(files, io, pool);
+  report.filesRead = scanner.readCount();
+  report.filesCached = scanner.cachedCount();
+  report.filesFailed = scanner.failedCount();
+
+  std::unordered_map<std::string_view, size_t> fileIndex = {};
+  for (size_t file = 0; file < files.size(); file++) {
+    fileIndex.emplace(files[file], file);
+  }
+
+  const HeaderIndex headers(projects);
+  std::vector<std::vector<ResolvedInclude>> resolved(files.size());
+  for (size_t file = 0; file < files.size(); file++) {
+    const auto project = fileProjects[file];
+    for (const auto& include : includes[file]) {
+      report.includes++;
+
+      HeaderIndex::Match match;
+      const auto result = headers.resolve(files[file], project, include, match);
+      if (result == HeaderIndex::Ambiguous) {
+        report.ambiguous++;
+      }
+      if (result != HeaderIndex::Found || (match.project != project && !projects[match.project].isLibrary)) {
+        continue;
+      }
+      report.resolved++;
+
+      const auto header = fileIndex.find(*match.path);
+      resolved[file].push_back({
+        match.project,
+        header != fileIndex.end() ? header->second : NoProject,
+        match.relative ? std::string() : headers.includeDirectory(match, include)
+      });
+    }
+  }
+
+  // only the headers other projects reach make include directories and links public, the rest
+  // stays off their search paths; every header being public is what the search paths are compared with
+  const auto exported = exportedHeaders(projects, fileProjects, fileIsHeader, resolved);
+  std::vector<char> filePublic(files.size(), 0);
+  for (size_t file = 0; file < files.size(); file++) {
+    filePublic[file] = fileIsHeader[file] && exported[file];
+  }
+  const auto usages = collectUsages(projects.size(), fileProjects, filePublic, resolved);
+  const auto allPublic = collectUsages(projects.size(), fileProjects, fileIsHeader, resolved);
+  const auto closures = publicClosures(usages);
+  const auto allPublicClosures = publicClosures(allPublic);
+
+  for (const auto& cycle : findCycles(usages)) {
+    std::vector<std::string> targets = {};
+    for (const auto member : cycle) {
+      targets.push_back(projects[member].target);
+    }
+    std::sort(targets.begin(), targets.end());
+    report.cycles.push_back(targets);
+  }
+
+  report.projects.resize(projects.size());
+  for (size_t i = 0; i < projects.size(); i++) {
+    auto& dependencies = report.projects[i];
+    const auto& usage = usages[i];
+
+    std::set<size_t> dropped = {};
+    for (const auto& library : usage.libraries) {
+      const bool redundant = std::any_of(usage.libraries.begin(), usage.libraries.end(), [&](const std::pair<const size_t, bool>& other) {
+        return other.first != library.first && dropped.count(other.first) == 0 && (other.second || !library.second)
+          && closures[other.first].count(library.first) != 0;
+      });
+      if (redundant) {
+        dropped.insert(library.first);
+        report.redundantLinks++;
+        continue;
+      }
+      (library.second ? dependencies.publicLibraries : dependencies.privateLibraries).push_back(projects[library.first].target);
+    }
+
+    dependencies.publicIncludeDirectories.assign(usage.publicDirectories.begin(), usage.publicDirectories.end());
+    for (const auto& directory : usage.privateDirectories) {
+      if (usage.publicDirectories.count(directory) == 0) {
+        dependencies.privateIncludeDirectories.push_back(directory);
+      }
+    }
+
+    const auto searched = searchDirectoryCount(usages, closures, i);
+    const auto searchedBefore = searchDirectoryCount(allPublic, allPublicClosures, i);
+    report.searchDirectories += searched;
+    if (searchedBefore > searched) {
+      report.searchPaths.push_back({projects[i].target, searched, searchedBefore - searched});
+    }
+  }
+
+  return report;
+}
+
+std::vector<std::string> DependencyReport::describe() const {
+  size_t links = 0;
+  size_t directories = 0;
+  for (const auto& project : projects) {
+    links += project.publicLibraries.size() + project.privateLibraries.size();
+    directories += project.publicIncludeDirectories.size() + project.privateIncludeDirectories.size();
+  }
+
+  std::vector<std::string> lines = {
+    "Inferred " + std::to_string(links) + " links and " + std::to_string(directories) + " include directories from "
+      + std::to_string(resolved) + " of " + std::to_string(includes) + " includes (" + std::to_string(filesRead) + " files scanned, "
+      + std::to_string(filesCached) + " cached, " + std::to_string(redundantLinks) + " links already inherited)"
+  };
+  if (!searchPaths.empty()) {
+    size_t removed = 0;
+    for (const auto& searchPath : searchPaths) {
+      removed += searchPath.removed;
+    }
+    lines.push_back("Kept " + std::to_string(searchDirectories) + " include search directories, removed " + std::to_string(removed)
+      + " that only private headers need from " + std::to_string(searchPaths.size()) + " targets");
+    for (const auto& searchPath : searchPaths) {
+      lines.push_back("  " + searchPath.target + ": " + std::to_string(searchPath.removed) + " of "
+        + std::to_string(searchPath.kept + searchPath.removed) + " removed");
+    }
+  }
+  if (filesFailed > 0) {
+    lines.push_back("Could not read " + std::to_string(filesFailed) + " files, their includes are left out");
+  }
+  if (ambiguous > 0) {
+    lines.push_back("Skipped " + std::to_string(ambiguous) + " includes matching headers of several projects");
+  }
+  for (const auto& cycle : cycles) {
+    std::string line = "Dependency cycle between";
+    for (size_t i = 0; i < cycle.size(); i++) {
+      line += (i == 0 ? " " : ", ") + cycle[i];
+    }
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+}
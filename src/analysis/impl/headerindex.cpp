@@ -0,0 +1,106 @@
+#include "../headerindex.h"
+#include "../includescanner.h"
+
+#include <algorithm>
+
+namespace analysis {
+namespace {
+  std::string_view includeName(const Include& include) {
+    std::string_view name = include.name;
+    return name.substr(0, 2) == "./" ? name.substr(2) : name;
+  }
+}
+
+HeaderIndex::HeaderIndex(const std::vector<ProjectModel>& projects)
+  : projects_(projects), headers_({}), suffixes_({}) {
+  for (size_t i = 0; i < projects.size(); i++) {
+    for (const auto& includeFile : projects[i].includeFiles) {
+      const Match match = {i, &includeFile, false};
+      headers_[includeFile] = match;
+
+      // every trailing run of path components is a name the header could be included by
+      for (auto slash = includeFile.find('/'); slash != std::string::npos; slash = includeFile.find('/', slash + 1)) {
+        suffixes_[std::string_view(includeFile).substr(slash + 1)].push_back(match);
+      }
+    }
+  }
+}
+
+HeaderIndex::Result HeaderIndex::resolve(const std::string& includingFile, size_t project, const Include& include, Match& match) const {
+  if (!include.angled) {
+    const auto directory = includingFile.substr(0, includingFile.find_last_of('/'));
+    const auto found = headers_.find(normalizePath(directory + "/" + include.name));
+    if (found != headers_.end()) {
+      match = found->second;
+      match.relative = true;
+      return Found;
+    }
+  }
+
+  const auto name = includeName(include);
+  const auto candidates = suffixes_.find(name);
+  if (name.find("..") != std::string_view::npos || candidates == suffixes_.end()) {
+    return NotFound;
+  }
+
+  const auto& matches = candidates->second;
+  auto own = std::find_if(matches.begin(), matches.end(), [project](const Match& candidate) {
+    return candidate.project == project;
+  });
+  if (own != matches.end()) {
+    match = *own;
+    return Found;
+  }
+
+  const auto owner = matches.front().project;
+  if (std::any_of(matches.begin(), matches.end(), [owner](const Match& candidate) { return candidate.project != owner; })) {
+    return Ambiguous;
+  }
+  match = matches.front();
+  return Found;
+}
+
+std::string HeaderIndex::includeDirectory(const Match& match, const Include& include) const {
+  const auto& projectPath = projects_[match.project].path;
+  const auto directory = match.path->substr(0, match.path->size() - includeName(include).size() - 1);
+  if (directory == projectPath) {
+    return ".";
+  }
+  if (projectPath == ".") {
+    return directory.substr(2);
+  }
+  if (directory.size() > projectPath.size() && directory.compare(0, projectPath.size(), projectPath) == 0 && directory[projectPath.size()] == '/') {
+    return directory.substr(projectPath.size() + 1);
+  }
+  return "";
+}
+
+std::string normalizePath(std::string_view path) {
+  std::vector<std::string_view> parts = {};
+  size_t start = 0;
+  while (start <= path.size()) {
+    auto end = path.find('/', start);
+    if (end == std::string_view::npos) {
+      end = path.size();
+    }
+    const auto part = path.substr(start, end - start);
+    if (part == "..") {
+      if (parts.empty()) {
+        return "";
+      }
+      parts.pop_back();
+    } else if (!part.empty() && part != ".") {
+      parts.push_back(part);
+    }
+    start = end + 1;
+  }
+
+  std::string normalized = ".";
+  for (const auto& part : parts) {
+    normalized += "/";
+    normalized += part;
+  }
+  return normalized;
+}
+
+}
@@ -0,0 +1,172 @@
+#include "../includescanner.h"
+#include "../../file_utils/batchio.h"
+#include "../../file_utils/fileutils.h"
+#include "../../threadpool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace analysis {
+
+const std::string IncludeCacheFile = "_build/.cmakegen-includes";
+
+namespace {
+  const std::string CacheHeader = "cmakegen includes 1";
+  // how many changed files are read at once
+  const size_t ReadBatch = 1024;
+
+  bool isBlank(char c) {
+    return c == ' ' || c == '\t';
+  }
+}
+
+std::vector<Include> scanIncludes(std::string_view source) {
+  std::vector<Include> includes = {};
+  const char* data = source.data();
+  const size_t size = source.size();
+  size_t position = 0;
+  while (position < size) {
+    const auto* hash = static_cast<const char*>(std::memchr(data + position, '#', size - position));
+    if (hash == nullptr) {
+      break;
+    }
+    const auto index = static_cast<size_t>(hash - data);
+    position = index + 1;
+
+    // only blanks may come before the # on its line
+    auto lineStart = index;
+    while (lineStart > 0 && isBlank(data[lineStart - 1])) {
+      lineStart--;
+    }
+    if (lineStart > 0 && data[lineStart - 1] != '\n') {
+      continue;
+    }
+
+    auto next = index + 1;
+    while (next < size && isBlank(data[next])) {
+      next++;
+    }
+    if (source.compare(next, 7, "include") != 0) {
+      continue;
+    }
+    next += 7;
+    while (next < size && isBlank(data[next])) {
+      next++;
+    }
+    if (next == size || (data[next] != '"' && data[next] != '<')) {
+      continue;
+    }
+
+    const bool angled = data[next] == '<';
+    const auto end = source.find_first_of(angled ? ">\n" : "\"\n", next + 1);
+    if (end == std::string_view::npos || data[end] == '\n' || end == next + 1) {
+      continue;
+    }
+    includes.push_back({std::string(source.substr(next + 1, end - next - 1)), angled});
+    position = end + 1;
+  }
+  return includes;
+}
+
+IncludeScanner::IncludeScanner(std::string cacheFile)
+  : cacheFile_(std::move(cacheFile)), cache_({}), scanned_({}), readCount_(0), cachedCount_(0), failedCount_(0) {
+  std::ifstream stream(cacheFile_);
+  std::string line;
+  if (!std::getline(stream, line) || line != CacheHeader) {
+    return;
+  }
+
+  // "<modified> <size> <path>" followed by one tab indented line per include, " or < and the name
+  Entry* entry = nullptr;
+  while (std::getline(stream, line)) {
+    if (line.size() > 2 && line[0] == '\t' && entry != nullptr) {
+      entry->includes.push_back({line.substr(2), line[1] == '<'});
+      continue;
+    }
+
+    std::istringstream fields(line);
+    Entry parsed = {0, 0, {}};
+    std::string path;
+    if (fields >> parsed.modified >> parsed.size && std::getline(fields >> std::ws, path) && !path.empty()) {
+      entry = &(cache_[path] = parsed);
+    } else {
+      entry = nullptr;
+    }
+  }
+}
+
+std::vector<std::vector<Include>> IncludeScanner::scan(const std::vector<std::string>& files, file_utils::BatchIo& io, const ThreadPool& pool) {
+  const auto statuses = io.stat(files);
+
+  std::vector<std::vector<Include>> includes(files.size());
+  std::vector<std::string> changedFiles = {};
+  std::vector<size_t> changedIndices = {};
+  for (size_t i = 0; i < files.size(); i++) {
+    const auto scanned = scanned_.find(files[i]);
+    const auto loaded = cache_.find(files[i]);
+    const Entry* cached = scanned != scanned_.end() ? &scanned->second : loaded != cache_.end() ? &loaded->second : nullptr;
+    const auto& status = statuses[i];
+    if (cached != nullptr && status.exists && status.modified != 0 && cached->modified == status.modified && cached->size == status.size) {
+      includes[i] = cached->includes;
+    } else {
+      changedFiles.push_back(files[i]);
+      changedIndices.push_back(i);
+    }
+  }
+
+  // changed files are read a batch at a time, so the whole tree is never held in memory at once
+  std::vector<char> failed(files.size(), 0);
+  for (size_t start = 0; start < changedFiles.size(); start += ReadBatch) {
+    const auto end = std::min(changedFiles.size(), start + ReadBatch);
+    const std::vector<std::string> batch(changedFiles.begin() + start, changedFiles.begin() + end);
+    const auto contents = io.readFiles(batch);
+    pool.forEach(batch.size(), [&](size_t i) {
+      if (contents[i].ok) {
+        includes[changedIndices[start + i]] = scanIncludes(contents[i].data);
+      } else {
+        failed[changedIndices[start + i]] = 1;
+      }
+    });
+  }
+
+  // a file that couldn't be read has no includes to remember, it is read again next time
+  failedCount_ = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    if (failed[i]) {
+      scanned_.erase(files[i]);
+      failedCount_++;
+    } else if (statuses[i].exists) {
+      scanned_[files[i]] = {statuses[i].modified, statuses[i].size, includes[i]};
+    }
+  }
+  readCount_ = changedFiles.size() - failedCount_;
+  cachedCount_ = files.size() - changedFiles.size();
+  return includes;
+}
+
+bool IncludeScanner::save() const {
+  std::string contents = CacheHeader + "\n";
+  for (const auto& [path, entry] : scanned_) {
+    contents += std::to_string(entry.modified) + " " + std::to_string(entry.size) + " " + path + "\n";
+    for (const auto& include : entry.includes) {
+      contents += "\t" + std::string(1, include.angled ? '<' : '"') + include.name + "\n";
+    }
+  }
+  return file_utils::replaceFile(cacheFile_, contents);
+}
+
+size_t IncludeScanner::readCount() const {
+  return readCount_;
+}
+
+size_t IncludeScanner::cachedCount() const {
+  return cachedCount_;
+}
+
+size_t IncludeScanner::failedCount() const {
+  return failedCount_;
+}
+
+}
@@ -0,0 +1,226 @@
+#include "../precompiledheaders.h"
+#include "../headerindex.h"
+#include "../includescanner.h"
+#include "../../cmake/managedsection.h"
+#include "../../file_utils/batchio.h"
+#include "../../iohandler.h"
+#include "../../processrunner.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+namespace analysis {
+
+const std::string PrecompiledHeadersSection = "precompiled headers";
+
+namespace {
+  const std::string SearchListStart = "#include <...> search starts here:";
+  const std::string SearchListEnd = "End of search list.";
+
+  class CollectingIoHandler : public IoHandler {
+  public:
+    void write(const std::string& text) override {
+      lines.push_back(text);
+    }
+
+    std::string input() override {
+      return "";
+    }
+
+    std::vector<std::string> lines;
+  };
+
+  // A header without a guard would be included twice, once through the precompiled header and once by the source.
+  bool hasIncludeGuard(std::string_view header) {
+    size_t position = 0;
+    while (position < header.size()) {
+      const auto next = header.find_first_not_of(" \t\r\n", position);
+      if (next == std::string_view::npos) {
+        return false;
+      }
+      if (header.compare(next, 2, "//") == 0) {
+        position = header.find('\n', next);
+      } else if (header.compare(next, 2, "/*") == 0) {
+        position = header.find("*/", next + 2);
+        position = position == std::string_view::npos ? position : position + 2;
+      } else {
+        return header.compare(next, 12, "#pragma once") == 0 || header.compare(next, 7, "#ifndef") == 0
+          || header.compare(next, 12, "#if !defined") == 0;
+      }
+    }
+    return false;
+  }
+
+  struct Candidate {
+    std::string header;
+    // the file that is statted for the size, empty for system headers that haven't been found yet
+    std::string path;
+    size_t translationUnits = 0;
+    size_t firstSeen = 0;
+  };
+}
+
+std::vector<std::vector<PrecompiledHeader>> selectPrecompiledHeaders(
+  const std::vector<ProjectModel>& projects,
+  const std::vector<std::string>& systemDirectories,
+  const PrecompiledHeaderOptions& options,
+  IncludeScanner& scanner,
+  file_utils::BatchIo& io,
+  const ThreadPool& pool
+) {
+  std::vector<std::string> files = {};
+  std::vector<size_t> fileProjects = {};
+  for (size_t i = 0; i < projects.size(); i++) {
+    for (const auto& sourceFile : projects[i].sourceFiles) {
+      files.push_back(sourceFile);
+      fileProjects.push_back(i);
+    }
+  }
+  const auto includes = scanner.scan(files, io, pool);
+
+  const HeaderIndex headers(projects);
+  std::vector<std::map<std::string, Candidate>> candidates(projects.size());
+  std::set<std::string> systemNames = {};
+  size_t order = 0;
+  for (size_t file = 0; file < files.size(); file++) {
+    const auto project = fileProjects[file];
+    std::set<std::string> seen = {};
+    for (const auto& include : includes[file]) {
+      HeaderIndex::Match match;
+      const auto result = headers.resolve(files[file], project, include, match);
+      if (result == HeaderIndex::Ambiguous) {
+        continue;
+      }
+
+      Candidate candidate;
+      if (result == HeaderIndex::Found) {
+        candidate.path = *match.path;
+        candidate.header = std::filesystem::path(*match.path).lexically_relative(projects[project].path).generic_string();
+      } else {
+        candidate.header = "<" + include.name + ">";
+        systemNames.insert(include.name);
+      }
+
+      if (!seen.insert(candidate.header).second) {
+        continue;
+      }
+      auto& counted = candidates[project].emplace(candidate.header, candidate).first->second;
+      if (counted.translationUnits++ == 0) {
+        counted.firstSeen = order++;
+      }
+    }
+  }
+
+  // system headers are found the way the compiler would, in the first directory that has them
+  std::vector<std::string> statPaths = {};
+  for (const auto& name : systemNames) {
+    for (const auto& directory : systemDirectories) {
+      statPaths.push_back(directory + "/" + name);
+    }
+  }
+  const auto common = [&projects, &options](size_t project, const Candidate& candidate) {
+    return candidate.translationUnits >= 2 && candidate.translationUnits * 100 >= options.minimumPercent * projects[project].sourceFiles.size();
+  };
+  std::set<std::string> projectHeaders = {};
+  for (size_t project = 0; project < projects.size(); project++) {
+    for (const auto& candidate : candidates[project]) {
+      if (!candidate.second.path.empty() && common(project, candidate.second)) {
+        projectHeaders.insert(candidate.second.path);
+      }
+    }
+  }
+  statPaths.insert(statPaths.end(), projectHeaders.begin(), projectHeaders.end());
+  const auto statuses = io.stat(statPaths);
+
+  // project headers common enough to be chosen are read to check for their guard
+  const auto projectHeaderContents = io.readFiles(std::vector<std::string>(projectHeaders.begin(), projectHeaders.end()));
+
+  std::unordered_map<std::string, unsigned long long> sizes = {};
+  size_t next = 0;
+  for (const auto& name : systemNames) {
+    for (size_t i = 0; i < systemDirectories.size(); i++, next++) {
+      if (statuses[next].exists && !statuses[next].isDirectory && sizes.count("<" + name + ">") == 0) {
+        sizes["<" + name + ">"] = statuses[next].size;
+      }
+    }
+  }
+  for (size_t i = 0; next < statPaths.size(); i++, next++) {
+    if (statuses[next].exists && projectHeaderContents[i].ok && hasIncludeGuard(projectHeaderContents[i].data)) {
+      sizes[statPaths[next]] = statuses[next].size;
+    }
+  }
+
+  std::vector<std::vector<PrecompiledHeader>> selected(projects.size());
+  for (size_t project = 0; project < projects.size(); project++) {
+    std::vector<std::pair<const Candidate*, unsigned long long>> ranked = {};
+    for (const auto& entry : candidates[project]) {
+      const auto& candidate = entry.second;
+      const auto size = sizes.find(candidate.path.empty() ? candidate.header : candidate.path);
+      if (size == sizes.end() || !common(project, candidate)) {
+        continue;
+      }
+      ranked.push_back({&candidate, size->second});
+    }
+
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+      const auto scoreA = a.first->translationUnits * a.second;
+      const auto scoreB = b.first->translationUnits * b.second;
+      return scoreA != scoreB ? scoreA > scoreB : a.first->firstSeen < b.first->firstSeen;
+    });
+    ranked.resize(std::min<size_t>(ranked.size(), options.maxHeaders));
+
+    // headers can depend on the ones included before them, the chosen ones keep the order they were first seen in
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+      return a.first->firstSeen < b.first->firstSeen;
+    });
+    for (const auto& [candidate, size] : ranked) {
+      selected[project].push_back({candidate->header, candidate->translationUnits, size});
+    }
+  }
+  return selected;
+}
+
+std::string renderPrecompiledHeaders(const std::string& target, const std::vector<PrecompiledHeader>& headers) {
+  if (headers.empty()) {
+    return "";
+  }
+
+  std::vector<std::string> arguments = {target, "PRIVATE"};
+  for (const auto& header : headers) {
+    arguments.push_back(header.header);
+  }
+  return "if(COMMAND target_precompile_headers)\n  " + cmake::renderFunction("target_precompile_headers", arguments) + "endif()\n";
+}
+
+std::vector<std::string> systemIncludeDirectories(const std::string& compiler) {
+  CollectingIoHandler output;
+  ProcessRunner runner(output);
+  if (runner.run({compiler, "-x", "c++", "-E", "-v", "/dev/null"}).exitCode != 0) {
+    return {};
+  }
+
+  std::vector<std::string> directories = {};
+  bool inSearchList = false;
+  for (const auto& line : output.lines) {
+    if (line == SearchListStart) {
+      inSearchList = true;
+    } else if (line == SearchListEnd) {
+      break;
+    } else if (inSearchList) {
+      auto directory = line.substr(line.find_first_not_of(' ') == std::string::npos ? line.size() : line.find_first_not_of(' '));
+      const auto framework = directory.find(" (framework directory)");
+      if (framework != std::string::npos) {
+        directory.erase(framework);
+      }
+      if (!directory.empty()) {
+        directories.push_back(std::filesystem::path(directory).lexically_normal().generic_string());
+      }
+    }
+  }
+  return directories;
+}
+
+}
@@ -0,0 +1,384 @@
+#include "../projectparts.h"
+#include "../headerindex.h"
+#include "../includescanner.h"
+#include "../../cmake/managedsection.h"
+#include "../../file_utils/batchio.h"
+#include "../../threadpool.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <set>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
+
+namespace analysis {
+
+const std::string ProjectPartsSection = "project parts";
+
+namespace {
+  const size_t NoPiece = static_cast<size_t>(-1);
+
+  struct Source {
+    // relative to the project, without the leading ./
+    std::string path;
+    unsigned long long bytes;
+  };
+
+  struct Piece {
+    // the directory all sources lie below, relative to the project with a trailing /, empty for the project itself
+    std::string directory;
+    std::vector<size_t> sources;
+    unsigned long long bytes;
+  };
+
+  std::string parentDirectory(std::string_view path) {
+    const auto slash = path.find_last_of('/');
+    return slash == std::string_view::npos ? "" : std::string(path.substr(0, slash + 1));
+  }
+
+  std::string commonDirectory(const std::string& a, const std::string& b) {
+    size_t length = 0;
+    for (size_t i = 0; i < std::min(a.size(), b.size()) && a[i] == b[i]; i++) {
+      if (a[i] == '/') {
+        length = i + 1;
+      }
+    }
+    return a.substr(0, length);
+  }
+
+  // The sources in [begin, end) lie below directory and are sorted by path, which keeps every subdirectory together.
+  void splitDirectory(
+    const std::vector<Source>& sources,
+    size_t begin,
+    size_t end,
+    const std::string& directory,
+    unsigned long long budget,
+    std::vector<Piece>& pieces
+  ) {
+    unsigned long long total = 0;
+    for (auto i = begin; i < end; i++) {
+      total += sources[i].bytes;
+    }
+    if (total <= budget) {
+      Piece piece = {directory, {}, total};
+      for (auto i = begin; i < end; i++) {
+        piece.sources.push_back(i);
+      }
+      pieces.push_back(std::move(piece));
+      return;
+    }
+
+    // the directory's own files are cut in path order, its subdirectories are split on their own
+    Piece own = {directory, {}, 0};
+    auto i = begin;
+    while (i < end) {
+      const auto& path = sources[i].path;
+      const auto slash = path.find('/', directory.size());
+      if (slash == std::string::npos) {
+        if (!own.sources.empty() && own.bytes + sources[i].bytes > budget) {
+          pieces.push_back(std::move(own));
+          own = {directory, {}, 0};
+        }
+        own.sources.push_back(i);
+        own.bytes += sources[i].bytes;
+        i++;
+        continue;
+      }
+
+      const auto subdirectory = path.substr(0, slash + 1);
+      auto next = i + 1;
+      while (next < end && sources[next].path.compare(0, subdirectory.size(), subdirectory) == 0) {
+        next++;
+      }
+      splitDirectory(sources, i, next, subdirectory, budget, pieces);
+      i = next;
+    }
+    if (!own.sources.empty()) {
+      pieces.push_back(std::move(own));
+    }
+  }
+
+  // Merges pieces below half the budget into the piece they share the most includes with, as long as both fit.
+  std::vector<Piece> mergeSmallPieces(
+    std::vector<Piece> pieces,
+    std::vector<std::unordered_map<size_t, size_t>> affinity,
+    unsigned long long budget
+  ) {
+    std::vector<char> merged(pieces.size(), 0);
+    std::vector<char> settled(pieces.size(), 0);
+    while (true) {
+      auto small = NoPiece;
+      for (size_t piece = 0; piece < pieces.size(); piece++) {
+        if (merged[piece] || settled[piece] || pieces[piece].bytes * 2 >= budget) {
+          continue;
+        }
+        if (small == NoPiece || std::tie(pieces[piece].bytes, pieces[piece].directory) < std::tie(pieces[small].bytes, pieces[small].directory)) {
+          small = piece;
+        }
+      }
+      if (small == NoPiece) {
+        break;
+      }
+
+      // the most shared includes, then the nearest directory, then the smallest piece
+      auto best = NoPiece;
+      std::tuple<size_t, size_t, unsigned long long> bestKey = {0, 0, 0};
+      for (size_t piece = 0; piece < pieces.size(); piece++) {
+        if (piece == small || merged[piece] || pieces[small].bytes + pieces[piece].bytes > budget) {
+          continue;
+        }
+        const auto shared = affinity[small].find(piece);
+        const std::tuple<size_t, size_t, unsigned long long> key = {
+          shared == affinity[small].end() ? 0 : shared->second,
+          commonDirectory(pieces[small].directory, pieces[piece].directory).size(),
+          ~pieces[piece].bytes
+        };
+        if (best == NoPiece || key > bestKey) {
+          best = piece;
+          bestKey = key;
+        }
+      }
+      if (best == NoPiece) {
+        settled[small] = 1;
+        continue;
+      }
+
+      auto& target = pieces[best];
+      target.sources.insert(target.sources.end(), pieces[small].sources.begin(), pieces[small].sources.end());
+      target.bytes += pieces[small].bytes;
+      target.directory = commonDirectory(target.directory, pieces[small].directory);
+      settled[best] = 0;
+      merged[small] = 1;
+      for (const auto& [other, count] : affinity[small]) {
+        affinity[other].erase(small);
+        if (other != best) {
+          affinity[best][other] += count;
+          affinity[other][best] += count;
+        }
+      }
+      affinity[best].erase(small);
+      affinity[small].clear();
+    }
+
+    std::vector<Piece> remaining = {};
+    for (size_t piece = 0; piece < pieces.size(); piece++) {
+      if (!merged[piece]) {
+        remaining.push_back(std::move(pieces[piece]));
+      }
+    }
+    return remaining;
+  }
+
+  std::string partName(const std::string& directory) {
+    std::string name = "";
+    for (const char c : directory.substr(0, directory.empty() ? 0 : directory.size() - 1)) {
+      const bool allowed = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+      name += allowed ? c : '_';
+    }
+    return name.empty() ? "part" : name;
+  }
+
+  bool isMainSource(std::string_view path) {
+    const auto name = path.substr(path.find_last_of('/') + 1);
+    return name.substr(0, name.find('.')) == "main";
+  }
+}
+
+std::vector<std::vector<ProjectPart>> planProjectParts(
+  const std::vector<ProjectModel>& projects,
+  const ProjectPartOptions& options,
+  IncludeScanner& scanner,
+  file_utils::BatchIo& io,
+  const ThreadPool& pool
+) {
+  std::vector<std::string> files = {};
+  for (const auto& project : projects) {
+    files.insert(files.end(), project.sourceFiles.begin(), project.sourceFiles.end());
+  }
+  const auto statuses = io.stat(files);
+
+  // only the projects over the budget are split, their sources are scanned for includes
+  std::vector<std::vector<Source>> sources(projects.size());
+  std::vector<std::string> scanFiles = {};
+  size_t file = 0;
+  for (size_t project = 0; project < projects.size(); project++) {
+    unsigned long long total = 0;
+    const auto first = file;
+    for (size_t i = 0; i < projects[project].sourceFiles.size(); i++, file++) {
+      total += statuses[file].exists ? statuses[file].size : 0;
+    }
+    if (total <= options.partBytes) {
+      continue;
+    }
+    for (auto i = first; i < file; i++) {
+      const auto path = std::filesystem::path(files[i]).lexically_relative(projects[project].path).generic_string();
+      sources[project].push_back({path, statuses[i].exists ? statuses[i].size : 0});
+      scanFiles.push_back(files[i]);
+    }
+  }
+  const auto includes = scanner.scan(scanFiles, io, pool);
+  const HeaderIndex headers(projects);
+
+  std::vector<std::vector<ProjectPart>> parts(projects.size());
+  size_t scanned = 0;
+  for (size_t project = 0; project < projects.size(); project++) {
+    if (sources[project].empty()) {
+      continue;
+    }
+
+    // the includes are kept by path, the scan order is the project's order before sorting
+    std::unordered_map<std::string, const std::vector<Include>*> sourceIncludes = {};
+    for (const auto& source : sources[project]) {
+      sourceIncludes[source.path] = &includes[scanned++];
+    }
+    auto& projectSources = sources[project];
+    std::sort(projectSources.begin(), projectSources.end(), [](const Source& a, const Source& b) {
+      return a.path < b.path;
+    });
+
+    std::vector<Piece> pieces = {};
+    splitDirectory(projectSources, 0, projectSources.size(), "", options.partBytes, pieces);
+    if (pieces.size() < 2) {
+      continue;
+    }
+
+    // a header belongs to the piece holding sources of its directory or the nearest one above it
+    std::unordered_map<std::string, size_t> directoryPieces = {};
+    for (size_t piece = 0; piece < pieces.size(); piece++) {
+      for (const auto source : pieces[piece].sources) {
+        directoryPieces[parentDirectory(projectSources[source].path)] = piece;
+      }
+    }
+    const auto pieceOf = [&directoryPieces](const std::string& path) {
+      auto directory = parentDirectory(path);
+      while (true) {
+        const auto found = directoryPieces.find(directory);
+        if (found != directoryPieces.end()) {
+          return found->second;
+        }
+        if (directory.empty()) {
+          return NoPiece;
+        }
+        directory = parentDirectory(std::string_view(directory).substr(0, directory.size() - 1));
+      }
+    };
+
+    std::vector<std::unordered_map<size_t, size_t>> affinity(pieces.size());
+    for (size_t piece = 0; piece < pieces.size(); piece++) {
+      for (const auto source : pieces[piece].sources) {
+        const auto sourcePath = projects[project].path + "/" + projectSources[source].path;
+        for (const auto& include : *sourceIncludes[projectSources[source].path]) {
+          HeaderIndex::Match match;
+          if (headers.resolve(sourcePath, project, include, match) != HeaderIndex::Found || match.project != project) {
+            continue;
+          }
+          const auto header = std::filesystem::path(*match.path).lexically_relative(projects[project].path).generic_string();
+          const auto other = pieceOf(header);
+          if (other != NoPiece && other != piece) {
+            affinity[piece][other]++;
+            affinity[other][piece]++;
+          }
+        }
+      }
+    }
+    pieces = mergeSmallPieces(std::move(pieces), std::move(affinity), options.partBytes);
+    if (pieces.size() < 2) {
+      continue;
+    }
+
+    auto kept = std::find_if(pieces.begin(), pieces.end(), [&projectSources](const Piece& piece) {
+      return std::any_of(piece.sources.begin(), piece.sources.end(), [&projectSources](size_t source) {
+        const auto& path = projectSources[source].path;
+        return path.find('/') == std::string::npos || isMainSource(path);
+      });
+    });
+    pieces.erase(kept == pieces.end() ? pieces.begin() : kept);
+
+    std::sort(pieces.begin(), pieces.end(), [](const Piece& a, const Piece& b) {
+      return a.directory < b.directory;
+    });
+    std::set<std::string> names = {};
+    for (const auto& piece : pieces) {
+      ProjectPart part = {partName(piece.directory), {}, piece.bytes};
+      for (int suffix = 2; !names.insert(part.name).second; suffix++) {
+        part.name = partName(piece.directory) + "_" + std::to_string(suffix);
+      }
+      for (const auto source : piece.sources) {
+        part.sources.push_back("./" + projectSources[source].path);
+      }
+      std::sort(part.sources.begin(), part.sources.end());
+      parts[project].push_back(std::move(part));
+    }
+  }
+  return parts;
+}
+
+std::unordered_set<std::string> partSources(const std::vector<ProjectPart>& parts) {
+  std::unordered_set<std::string> sources = {};
+  for (const auto& part : parts) {
+    sources.insert(part.sources.begin(), part.sources.end());
+  }
+  return sources;
+}
+
+std::vector<ProjectPart> parseProjectParts(std::string_view contents, const std::string& target) {
+  std::vector<ProjectPart> parts = {};
+  std::istringstream lines(cmake::managedSection(contents, ProjectPartsSection));
+  std::string line;
+  const std::string call = "add_library(";
+  while (std::getline(lines, line)) {
+    const auto start = line.find_first_not_of(" \t");
+    const auto end = line.find_last_of(')');
+    if (start == std::string::npos || line.compare(start, call.size(), call) != 0 || end == std::string::npos) {
+      continue;
+    }
+
+    std::istringstream arguments(line.substr(start + call.size(), end - start - call.size()));
+    std::string name;
+    std::string type;
+    if (!(arguments >> name >> type) || type != "OBJECT") {
+      continue;
+    }
+    ProjectPart part = {name.compare(0, target.size() + 1, target + "_") == 0 ? name.substr(target.size() + 1) : name, {}, 0};
+    std::string source;
+    while (arguments >> source) {
+      part.sources.push_back(source);
+    }
+    parts.push_back(std::move(part));
+  }
+  return parts;
+}
+
+std::string renderProjectParts(const std::string& target, const std::vector<ProjectPart>& parts) {
+  if (parts.empty()) {
+    return "";
+  }
+
+  std::string body = "if(NOT CMAKE_VERSION VERSION_LESS 3.12)\n";
+  std::vector<std::string> libraries = {"part"};
+  for (const auto& part : parts) {
+    std::vector<std::string> arguments = {target + "_" + part.name, "OBJECT"};
+    arguments.insert(arguments.end(), part.sources.begin(), part.sources.end());
+    body += "  " + cmake::renderFunction("add_library", arguments);
+    libraries.push_back(target + "_" + part.name);
+  }
+  body += "  " + cmake::renderFunction("foreach", libraries);
+  body += "    " + cmake::renderFunction("target_include_directories", {"${part}", "PRIVATE", "$<TARGET_PROPERTY:" + target + ",INCLUDE_DIRECTORIES>"});
+  body += "    " + cmake::renderFunction("target_compile_definitions", {"${part}", "PRIVATE", "$<TARGET_PROPERTY:" + target + ",COMPILE_DEFINITIONS>"});
+  body += "    " + cmake::renderFunction("target_compile_options", {"${part}", "PRIVATE", "$<TARGET_PROPERTY:" + target + ",COMPILE_OPTIONS>"});
+  body += "    " + cmake::renderFunction("target_compile_features", {"${part}", "PRIVATE", "$<TARGET_PROPERTY:" + target + ",COMPILE_FEATURES>"});
+  body += "    " + cmake::renderFunction("target_link_libraries", {"${part}", "PRIVATE", "$<TARGET_PROPERTY:" + target + ",LINK_LIBRARIES>"});
+  body += "    " + cmake::renderFunction("target_sources", {target, "PRIVATE", "$<TARGET_OBJECTS:${part}>"});
+  body += "  endforeach()\n";
+
+  body += "else()\n";
+  std::vector<std::string> arguments = {target, "PRIVATE"};
+  for (const auto& part : parts) {
+    arguments.insert(arguments.end(), part.sources.begin(), part.sources.end());
+  }
+  body += "  " + cmake::renderFunction("target_sources", arguments);
+  return body + "endif()\n";
+}
+
+}
@@ -0,0 +1,297 @@
+#include "../testtargets.h"
+#include "../../cmake/managedsection.h"
+#include "../../file_utils/batchio.h"
+#include "../../file_utils/fileutils.h"
+#include "../../generationrules.h"
+#include "../../threadpool.h"
+
+#include <algorithm>
+#include <functional>
+#include <set>
+#include <sstream>
+
+namespace analysis {
+
+const std::string TestsSection = "tests";
+const std::string TestingSection = "testing";
+
+namespace {
+  // paths are matched without the ./ every walked path starts with
+  std::string_view rootRelative(std::string_view path) {
+    return path.substr(0, 2) == "./" ? path.substr(2) : path;
+  }
+
+  bool matchesAny(const std::vector<std::string>& patterns, std::string_view path) {
+    return std::any_of(patterns.begin(), patterns.end(), [path](const std::string& pattern) {
+      return file_utils::matchesGlob(pattern, path);
+    });
+  }
+
+  TestFramework detectFramework(std::string_view source) {
+    if (source.find("gtest/gtest.h") != std::string_view::npos || source.find("gmock/gmock.h") != std::string_view::npos) {
+      return TestFramework::GoogleTest;
+    }
+    // Catch2 3 comes as catch2/catch_*.hpp headers, the single header of Catch2 2 has no cmake package to discover tests with
+    return source.find("catch2/catch_") != std::string_view::npos ? TestFramework::Catch2 : TestFramework::None;
+  }
+
+  std::string testName(std::string_view source) {
+    const auto fileName = source.substr(source.find_last_of('/') + 1);
+    std::string name = "";
+    for (const char c : fileName.substr(0, fileName.find('.'))) {
+      const bool allowed = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+      name += allowed ? c : '_';
+    }
+    return name.empty() ? "test" : name;
+  }
+
+  // calls visit with the name and the remaining arguments of every call to function in the tests section
+  void visitTestCalls(
+    std::string_view contents,
+    const std::string& function,
+    const std::function<void(const std::string&, std::istringstream&)>& visit
+  ) {
+    std::istringstream lines(cmake::managedSection(contents, TestsSection));
+    std::string line;
+    const std::string call = function + "(";
+    while (std::getline(lines, line)) {
+      const auto start = line.find_first_not_of(" \t");
+      const auto end = line.find_last_of(')');
+      if (start == std::string::npos || line.compare(start, call.size(), call) != 0 || end == std::string::npos) {
+        continue;
+      }
+
+      std::istringstream arguments(line.substr(start + call.size(), end - start - call.size()));
+      std::string name;
+      if (arguments >> name) {
+        visit(name, arguments);
+      }
+    }
+  }
+
+  std::vector<std::string> testProperties(const TestTarget& test) {
+    std::vector<std::string> properties = {};
+    if (!test.resourceLocks.empty()) {
+      std::string locks = "";
+      for (const auto& lock : test.resourceLocks) {
+        locks += (locks.empty() ? "" : ";") + lock;
+      }
+      properties.insert(properties.end(), {"RESOURCE_LOCK", "\"" + locks + "\""});
+    }
+    if (test.processors != 0) {
+      properties.insert(properties.end(), {"PROCESSORS", std::to_string(test.processors)});
+    }
+    return properties;
+  }
+}
+
+bool isTestSource(const TestOptions& options, std::string_view path) {
+  return matchesAny(options.patterns, rootRelative(path));
+}
+
+std::vector<std::vector<TestTarget>> planTests(
+  const std::vector<ProjectModel>& projects,
+  const TestOptions& options,
+  file_utils::BatchIo& io,
+  const ThreadPool& pool
+) {
+  std::vector<std::string> files = {};
+  std::vector<size_t> owners = {};
+  for (size_t project = 0; project < projects.size(); project++) {
+    for (const auto& source : projects[project].sourceFiles) {
+      if (isTestSource(options, source)) {
+        files.push_back(source);
+        owners.push_back(project);
+      }
+    }
+  }
+
+  const auto prefixes = io.readPrefixes(files, options.prefixBytes);
+  std::vector<TestFramework> frameworks(files.size(), TestFramework::None);
+  std::vector<char> hasMain(files.size(), 0);
+  pool.forEach(files.size(), [&prefixes, &frameworks, &hasMain](size_t i) {
+    if (prefixes[i].ok) {
+      frameworks[i] = detectFramework(prefixes[i].data);
+      hasMain[i] = definesMain(prefixes[i].data);
+    }
+  });
+
+  std::vector<std::vector<TestTarget>> tests(projects.size());
+  std::vector<std::vector<std::string>> helpers(projects.size());
+  std::vector<std::set<std::string>> names(projects.size());
+  for (size_t i = 0; i < files.size(); i++) {
+    const auto& project = projects[owners[i]];
+    const auto source = file_utils::makeRelative(files[i], project.path);
+    if (frameworks[i] == TestFramework::None && !hasMain[i]) {
+      helpers[owners[i]].push_back(source);
+      continue;
+    }
+
+    // test names stay unique within the project, a_test.cpp in two directories becomes a_test and a_test_2
+    const auto base = testName(source);
+    auto name = base;
+    for (int suffix = 2; names[owners[i]].count(name) != 0; suffix++) {
+      name = base + "_" + std::to_string(suffix);
+    }
+    names[owners[i]].insert(name);
+
+    TestTarget test = {name, {source}, frameworks[i], hasMain[i] != 0, {}, 0};
+    const auto path = rootRelative(files[i]);
+    for (const auto& lock : options.resourceLocks) {
+      if (file_utils::matchesGlob(lock.first, path)
+        && std::find(test.resourceLocks.begin(), test.resourceLocks.end(), lock.second) == test.resourceLocks.end()) {
+        test.resourceLocks.push_back(lock.second);
+      }
+    }
+    const auto processors = std::find_if(options.processors.begin(), options.processors.end(), [path](const auto& rule) {
+      return file_utils::matchesGlob(rule.first, path);
+    });
+    test.processors = processors != options.processors.end() ? processors->second : 0;
+    tests[owners[i]].push_back(std::move(test));
+  }
+
+  for (size_t project = 0; project < projects.size(); project++) {
+    // a project of test sources only is a test program of its own and has no target to test
+    if (tests[project].size() + helpers[project].size() == projects[project].sourceFiles.size()) {
+      tests[project].clear();
+    }
+    for (auto& test : tests[project]) {
+      test.sources.insert(test.sources.end(), helpers[project].begin(), helpers[project].end());
+    }
+  }
+  return tests;
+}
+
+std::unordered_set<std::string> testSources(const std::vector<TestTarget>& tests) {
+  std::unordered_set<std::string> sources = {};
+  for (const auto& test : tests) {
+    sources.insert(test.sources.begin(), test.sources.end());
+  }
+  return sources;
+}
+
+std::vector<std::string> testExecutables(const std::string& target, const std::vector<TestTarget>& tests) {
+  std::vector<std::string> executables = {};
+  for (const auto& test : tests) {
+    executables.push_back(target + "_" + test.name);
+  }
+  return executables;
+}
+
+std::unordered_set<std::string> parseTestSources(std::string_view contents) {
+  std::unordered_set<std::string> sources = {};
+  visitTestCalls(contents, "add_executable", [&sources](const std::string&, std::istringstream& arguments) {
+    for (std::string source; arguments >> source;) {
+      sources.insert(source);
+    }
+  });
+  return sources;
+}
+
+std::vector<std::string> parseTestExecutables(std::string_view contents) {
+  std::vector<std::string> executables = {};
+  visitTestCalls(contents, "add_executable", [&executables](const std::string& name, std::istringstream&) {
+    executables.push_back(name);
+  });
+  return executables;
+}
+
+std::vector<TestTarget> parseTests(std::string_view contents, const std::string& target) {
+  std::vector<TestTarget> tests = {};
+  visitTestCalls(contents, "add_executable", [&tests, &target](const std::string& executable, std::istringstream& arguments) {
+    const auto prefix = target + "_";
+    TestTarget test = {
+      executable.compare(0, prefix.size(), prefix) == 0 ? executable.substr(prefix.size()) : executable, {}, TestFramework::None, true, {}, 0
+    };
+    for (std::string source; arguments >> source;) {
+      test.sources.push_back(source);
+    }
+    tests.push_back(std::move(test));
+  });
+
+  const auto executables = testExecutables(target, tests);
+  visitTestCalls(contents, "target_link_libraries", [&](const std::string& executable, std::istringstream& arguments) {
+    const auto found = std::find(executables.begin(), executables.end(), executable);
+    if (found == executables.end()) {
+      return;
+    }
+    auto& test = tests[static_cast<size_t>(found - executables.begin())];
+    for (std::string library; arguments >> library;) {
+      if (library == "GTest::GTest") {
+        test.framework = TestFramework::GoogleTest;
+      } else if (library == "GTest::Main") {
+        test.definesMain = false;
+      } else if (library == "Catch2::Catch2") {
+        test.framework = TestFramework::Catch2;
+      } else if (library == "Catch2::Catch2WithMain") {
+        test.framework = TestFramework::Catch2;
+        test.definesMain = false;
+      }
+    }
+  });
+  return tests;
+}
+
+std::string renderTests(const std::string& target, bool linkTarget, const std::vector<TestTarget>& tests) {
+  if (tests.empty()) {
+    return "";
+  }
+
+  const auto uses = [&tests](TestFramework framework) {
+    return std::any_of(tests.begin(), tests.end(), [framework](const TestTarget& test) { return test.framework == framework; });
+  };
+  std::string body = "";
+  if (uses(TestFramework::GoogleTest)) {
+    body += cmake::renderFunction("find_package", {"GTest", "REQUIRED"});
+    body += cmake::renderFunction("include", {"GoogleTest"});
+  }
+  if (uses(TestFramework::Catch2)) {
+    body += cmake::renderFunction("find_package", {"Catch2", "3", "REQUIRED"});
+    body += cmake::renderFunction("include", {"Catch"});
+  }
+
+  const auto executables = testExecutables(target, tests);
+  for (size_t i = 0; i < tests.size(); i++) {
+    const auto& test = tests[i];
+    const auto& executable = executables[i];
+    std::vector<std::string> arguments = {executable};
+    arguments.insert(arguments.end(), test.sources.begin(), test.sources.end());
+    body += cmake::renderFunction("add_executable", arguments);
+    body += cmake::renderFunction("target_include_directories", {executable, "PRIVATE", "$<TARGET_PROPERTY:" + target + ",INCLUDE_DIRECTORIES>"});
+    body += cmake::renderFunction("target_compile_definitions", {executable, "PRIVATE", "$<TARGET_PROPERTY:" + target + ",COMPILE_DEFINITIONS>"});
+    body += cmake::renderFunction("target_compile_options", {executable, "PRIVATE", "$<TARGET_PROPERTY:" + target + ",COMPILE_OPTIONS>"});
+    body += cmake::renderFunction("target_compile_features", {executable, "PRIVATE", "$<TARGET_PROPERTY:" + target + ",COMPILE_FEATURES>"});
+
+    std::vector<std::string> links = {executable, "PRIVATE", linkTarget ? target : "$<TARGET_PROPERTY:" + target + ",LINK_LIBRARIES>"};
+    if (test.framework == TestFramework::GoogleTest) {
+      links.push_back("GTest::GTest");
+      if (!test.definesMain) {
+        links.push_back("GTest::Main");
+      }
+    } else if (test.framework == TestFramework::Catch2) {
+      links.push_back(test.definesMain ? "Catch2::Catch2" : "Catch2::Catch2WithMain");
+    }
+    body += cmake::renderFunction("target_link_libraries", links);
+
+    // the frameworks list their test cases and register every one of them, the others are one test each
+    const auto properties = testProperties(test);
+    if (test.framework == TestFramework::None) {
+      body += cmake::renderFunction("add_test", {"NAME", executable, "COMMAND", executable});
+      if (!properties.empty()) {
+        std::vector<std::string> propertyArguments = {executable, "PROPERTIES"};
+        propertyArguments.insert(propertyArguments.end(), properties.begin(), properties.end());
+        body += cmake::renderFunction("set_tests_properties", propertyArguments);
+      }
+    } else {
+      std::vector<std::string> discoverArguments = {executable};
+      if (!properties.empty()) {
+        discoverArguments.push_back("PROPERTIES");
+        discoverArguments.insert(discoverArguments.end(), properties.begin(), properties.end());
+      }
+      body += cmake::renderFunction(test.framework == TestFramework::GoogleTest ? "gtest_discover_tests" : "catch_discover_tests", discoverArguments);
+    }
+  }
+  return body;
+}
+
+}
@@ -0,0 +1,354 @@
+#include "../unitybuild.h"
+#include "../../cmake/managedsection.h"
+#include "../../file_utils/batchio.h"
+#include "../../threadpool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <set>
+
+namespace analysis {
+
+const std::string UnityBuildSection = "unity build";
+
+namespace {
+  // names that come before a ( or = without being declared there
+  const std::set<std::string_view> NotDeclared = {
+    "static_assert", "operator", "alignas", "decltype", "__attribute__", "__declspec", "noexcept", "sizeof"
+  };
+
+  bool isIdentifierStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+  }
+
+  bool isIdentifierChar(char c) {
+    return isIdentifierStart(c) || (c >= '0' && c <= '9');
+  }
+
+  bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+  }
+
+  // The identifiers and punctuation of a source without comments, literals and preprocessor lines,
+  // the names of the macros it defines are added to macros.
+  std::vector<std::string_view> tokenize(std::string_view source, std::vector<std::string>& macros) {
+    std::vector<std::string_view> tokens = {};
+    const auto size = source.size();
+    size_t position = 0;
+    bool lineStart = true;
+    const auto skipLine = [&source, &position, size]() {
+      while (position < size && source[position] != '\n') {
+        position += source[position] == '\\' ? 2 : 1;
+      }
+    };
+
+    while (position < size) {
+      const char c = source[position];
+      if (c == '\n') {
+        lineStart = true;
+        position++;
+      } else if (isBlank(c)) {
+        position++;
+      } else if (c == '#' && lineStart) {
+        auto next = source.find_first_not_of(" \t", position + 1);
+        if (next != std::string_view::npos && source.compare(next, 6, "define") == 0) {
+          next = source.find_first_not_of(" \t", next + 6);
+          auto end = next;
+          while (end < size && isIdentifierChar(source[end])) {
+            end++;
+          }
+          if (end != next) {
+            macros.emplace_back(source.substr(next, end - next));
+          }
+        }
+        skipLine();
+      } else if (source.compare(position, 2, "//") == 0) {
+        skipLine();
+      } else if (source.compare(position, 2, "/*") == 0) {
+        const auto end = source.find("*/", position + 2);
+        position = end == std::string_view::npos ? size : end + 2;
+      } else if (c == '"' || c == '\'') {
+        lineStart = false;
+        const bool raw = c == '"' && !tokens.empty() && tokens.back().back() == 'R'
+          && tokens.back().data() + tokens.back().size() == source.data() + position;
+        if (raw) {
+          tokens.pop_back();
+          const auto open = source.find('(', position);
+          const auto delimiter = ")" + std::string(source.substr(position + 1, open - position - 1)) + "\"";
+          const auto end = open == std::string_view::npos ? open : source.find(delimiter, open);
+          position = end == std::string_view::npos ? size : end + delimiter.size();
+          continue;
+        }
+        position++;
+        while (position < size && source[position] != c && source[position] != '\n') {
+          position += source[position] == '\\' ? 2 : 1;
+        }
+        position++;
+      } else if (c >= '0' && c <= '9') {
+        // digit separators and exponents stay part of the number
+        while (position < size && (isIdentifierChar(source[position]) || source[position] == '.' || source[position] == '\'')) {
+          position++;
+        }
+        lineStart = false;
+      } else if (isIdentifierStart(c)) {
+        const auto start = position;
+        while (position < size && isIdentifierChar(source[position])) {
+          position++;
+        }
+        tokens.push_back(source.substr(start, position - start));
+        lineStart = false;
+      } else {
+        tokens.push_back(source.substr(position, 1));
+        position++;
+        lineStart = false;
+      }
+    }
+    return tokens;
+  }
+
+  std::uint64_t hashPath(std::string_view path) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const char c : path) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    // fnv-1a leaves the high bits poorly mixed for paths that only differ at the end
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash;
+  }
+
+  std::string groupName(std::string_view firstSource) {
+    static const char* Digits = "0123456789abcdef";
+    auto hash = hashPath(firstSource);
+    // cmake names the unity file unity_<name>_cxx.cxx
+    std::string name = "";
+    for (int i = 0; i < 8; i++, hash >>= 4) {
+      name += Digits[hash & 0xf];
+    }
+    return name;
+  }
+
+  struct Source {
+    std::string path;
+    unsigned long long size;
+    std::vector<std::string> names;
+  };
+
+  std::vector<UnityGroup> groupSources(std::vector<Source> sources, unsigned long long batchBytes) {
+    std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) {
+      return a.path < b.path;
+    });
+
+    const auto minimumBytes = batchBytes / 2;
+    const auto maximumBytes = batchBytes * 2;
+    std::vector<UnityGroup> groups = {};
+    UnityGroup group = {"", {}, 0};
+    std::set<std::string> groupNames = {};
+    const auto close = [&groups, &group, &groupNames]() {
+      if (group.sources.size() >= 2) {
+        group.name = groupName(group.sources.front());
+        groups.push_back(std::move(group));
+      }
+      group = {"", {}, 0};
+      groupNames.clear();
+    };
+
+    for (auto& source : sources) {
+      const bool clashes = std::any_of(source.names.begin(), source.names.end(), [&groupNames](const std::string& name) {
+        return groupNames.count(name) != 0;
+      });
+      if (!group.sources.empty() && (clashes || group.bytes + source.size > maximumBytes)) {
+        close();
+      }
+      group.sources.push_back(source.path);
+      group.bytes += source.size;
+      groupNames.insert(source.names.begin(), source.names.end());
+
+      // past the minimum a source ends the group with a likelihood of its share of the remaining half
+      // batch, which only depends on the source itself and keeps the boundaries where they were
+      const double likelihood = minimumBytes == 0 ? 1.0 : static_cast<double>(source.size) / static_cast<double>(minimumBytes);
+      const double draw = static_cast<double>(hashPath(source.path) >> 11) / static_cast<double>(1ull << 53);
+      if (group.bytes >= minimumBytes && draw < likelihood) {
+        close();
+      }
+    }
+    close();
+    return groups;
+  }
+}
+
+std::vector<std::string> internalNames(std::string_view source) {
+  std::vector<std::string> names = {};
+  const auto tokens = tokenize(source, names);
+
+  struct Scope {
+    bool isNamespace;
+    bool anonymous;
+  };
+  std::vector<Scope> scopes = {};
+  const auto atNamespaceScope = [&scopes]() {
+    return std::all_of(scopes.begin(), scopes.end(), [](const Scope& scope) { return scope.isNamespace; });
+  };
+  const auto inAnonymousNamespace = [&scopes]() {
+    return std::any_of(scopes.begin(), scopes.end(), [](const Scope& scope) { return scope.anonymous; });
+  };
+
+  // the identifiers of the current declaration at namespace scope up to its name
+  std::vector<std::string_view> words = {};
+  bool named = false;
+  int parentheses = 0;
+  const auto has = [&words](std::string_view word) {
+    return std::find(words.begin(), words.end(), word) != words.end();
+  };
+  const auto declare = [&](bool function) {
+    named = true;
+    if (words.empty() || NotDeclared.count(words.back()) != 0) {
+      return;
+    }
+    const bool internal = inAnonymousNamespace() || has("static")
+      || (!function && (has("const") || has("constexpr")) && !has("extern"));
+    if (internal) {
+      names.emplace_back(words.back());
+    }
+  };
+  const auto reset = [&words, &named]() {
+    words.clear();
+    named = false;
+  };
+
+  for (const auto& token : tokens) {
+    if (!atNamespaceScope()) {
+      if (token == "{") {
+        scopes.push_back({false, false});
+      } else if (token == "}") {
+        scopes.pop_back();
+        if (atNamespaceScope()) {
+          reset();
+        }
+      }
+      continue;
+    }
+
+    if (parentheses > 0) {
+      parentheses += token == "(" ? 1 : token == ")" ? -1 : 0;
+      continue;
+    }
+    if (isIdentifierStart(token.front())) {
+      if (!named) {
+        words.push_back(token);
+      }
+      continue;
+    }
+
+    if (token == ";") {
+      if (!named) {
+        declare(false);
+      }
+      reset();
+    } else if (token == "(") {
+      if (!named) {
+        declare(true);
+      }
+      parentheses = 1;
+    } else if (token == "=" || token == "[") {
+      // a leading [ opens an attribute
+      if (!named && !words.empty()) {
+        declare(false);
+      }
+    } else if (token == "{") {
+      if (!words.empty() && (words.front() == "namespace" || (words.front() == "inline" && has("namespace")))) {
+        scopes.push_back({true, words.back() == "namespace"});
+        reset();
+        continue;
+      }
+      if (words.size() == 1 && words.front() == "extern") {
+        // extern "C", the string was dropped with the other literals
+        scopes.push_back({true, false});
+        reset();
+        continue;
+      }
+      if (!named) {
+        const auto type = std::find_if(words.begin(), words.end(), [](std::string_view word) {
+          return word == "struct" || word == "class" || word == "union" || word == "enum";
+        });
+        auto name = type == words.end() ? words.end() : type + 1;
+        while (name != words.end() && (*name == "class" || *name == "struct")) {
+          name++;
+        }
+        if (name != words.end()) {
+          words.erase(name + 1, words.end());
+          declare(false);
+        } else if (type == words.end()) {
+          // braced initializer
+          declare(false);
+        }
+        named = true;
+      }
+      scopes.push_back({false, false});
+    } else if (token == "}") {
+      if (!scopes.empty()) {
+        scopes.pop_back();
+      }
+      reset();
+    }
+  }
+
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+  return names;
+}
+
+std::vector<std::vector<UnityGroup>> planUnityBuilds(
+  const std::vector<ProjectModel>& projects,
+  const UnityBuildOptions& options,
+  file_utils::BatchIo& io,
+  const ThreadPool& pool
+) {
+  std::vector<std::string> files = {};
+  for (const auto& project : projects) {
+    files.insert(files.end(), project.sourceFiles.begin(), project.sourceFiles.end());
+  }
+  const auto contents = io.readFiles(files);
+  std::vector<std::vector<std::string>> names(files.size());
+  pool.forEach(files.size(), [&contents, &names](size_t i) {
+    if (contents[i].ok) {
+      names[i] = internalNames(contents[i].data);
+    }
+  });
+
+  std::vector<std::vector<UnityGroup>> groups(projects.size());
+  size_t file = 0;
+  for (size_t project = 0; project < projects.size(); project++) {
+    std::vector<Source> sources = {};
+    for (size_t i = 0; i < projects[project].sourceFiles.size(); i++, file++) {
+      if (!contents[file].ok) {
+        continue;
+      }
+      // written the way SRC_FILES lists them, cmake doesn't match "src/a.cpp" with "./src/a.cpp"
+      const auto path = "./" + std::filesystem::path(files[file]).lexically_relative(projects[project].path).generic_string();
+      sources.push_back({path, contents[file].data.size(), std::move(names[file])});
+    }
+    groups[project] = groupSources(std::move(sources), options.batchBytes);
+  }
+  return groups;
+}
+
+std::string renderUnityBuild(const std::string& target, const std::vector<UnityGroup>& groups) {
+  if (groups.empty()) {
+    return "";
+  }
+
+  // unity groups came with cmake 3.18, older versions build the sources one by one
+  std::string body = "if(NOT CMAKE_VERSION VERSION_LESS 3.18)\n";
+  body += "  " + cmake::renderFunction("set_target_properties", {target, "PROPERTIES", "UNITY_BUILD", "ON", "UNITY_BUILD_MODE", "GROUP"});
+  for (const auto& group : groups) {
+    std::vector<std::string> arguments = group.sources;
+    arguments.insert(arguments.end(), {"PROPERTIES", "UNITY_GROUP", group.name});
+    body += "  " + cmake::renderFunction("set_source_files_properties", arguments);
+  }
+  return body + "endif()\n";
+}
+
+}
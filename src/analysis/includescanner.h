@@ -0,0 +1,63 @@
+#ifndef ANALYSIS_INCLUDESCANNER_H
+#define ANALYSIS_INCLUDESCANNER_H
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class ThreadPool;
+
+namespace file_utils {
+class BatchIo;
+}
+
+namespace analysis {
+
+struct Include {
+  std::string name;
+  bool angled;
+};
+
+// The #include directives of a source, found by jumping from # to # with memchr. Conditional
+// compilation and comments aren't evaluated, so every include that could be used is listed.
+std::vector<Include> scanIncludes(std::string_view source);
+
+// Where cmakegen keeps the results between runs, below the build directory so walks skip it.
+extern const std::string IncludeCacheFile;
+
+// Scans many files at once and remembers the results by modification time and size, files that
+// didn't change since the cache was written aren't read again.
+class IncludeScanner {
+public:
+  explicit IncludeScanner(std::string cacheFile);
+
+  // The includes of every file in the order given, statted and read in batches and scanned in parallel.
+  // Files that can't be read have no includes and are left out of the cache.
+  std::vector<std::vector<Include>> scan(const std::vector<std::string>& files, file_utils::BatchIo& io, const ThreadPool& pool);
+
+  // Writes the results of every scan so far, files none of them covered are dropped from the cache.
+  bool save() const;
+
+  size_t readCount() const;
+  size_t cachedCount() const;
+  // the files of the last scan that couldn't be read
+  size_t failedCount() const;
+
+private:
+  struct Entry {
+    unsigned long long modified;
+    unsigned long long size;
+    std::vector<Include> includes;
+  };
+
+  std::string cacheFile_;
+  std::unordered_map<std::string, Entry> cache_;
+  std::unordered_map<std::string, Entry> scanned_;
+  size_t readCount_;
+  size_t cachedCount_;
+  size_t failedCount_;
+};
+
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef ANALYSIS_PRECOMPILEDHEADERS_H
+#define ANALYSIS_PRECOMPILEDHEADERS_H
+#include <string>
+#include <vector>
+
+#include "../projectmodel.h"
+
+class ThreadPool;
+
+namespace file_utils {
+class BatchIo;
+}
+
+namespace analysis {
+
+class IncludeScanner;
+
+struct PrecompiledHeaderOptions {
+  // the most headers that go into the precompiled header of one target
+  unsigned int maxHeaders = 10;
+  // how many of the target's sources, in percent, have to include a header for it to be considered
+  unsigned int minimumPercent = 50;
+};
+
+struct PrecompiledHeader {
+  // as target_precompile_headers takes it, <name> for system headers and a path relative to the project otherwise
+  std::string header;
+  size_t translationUnits;
+  unsigned long long size;
+};
+
+// The headers worth precompiling for every project: the ones most of its sources include directly,
+// ranked by how many do weighted by the size of the header and listed in the order they are first
+// included. System headers are looked up in systemDirectories and left out when they aren't found there,
+// project headers are left out when they have no include guard.
+std::vector<std::vector<PrecompiledHeader>> selectPrecompiledHeaders(
+  const std::vector<ProjectModel>& projects,
+  const std::vector<std::string>& systemDirectories,
+  const PrecompiledHeaderOptions& options,
+  IncludeScanner& scanner,
+  file_utils::BatchIo& io,
+  const ThreadPool& pool
+);
+
+// The CMakeLists.txt section holding them.
+extern const std::string PrecompiledHeadersSection;
+
+// The body of that section for a target, guarded for cmake versions before 3.16. Empty without headers.
+std::string renderPrecompiledHeaders(const std::string& target, const std::vector<PrecompiledHeader>& headers);
+
+// The directories the compiler searches for <> includes according to its -v output, empty when it couldn't be run.
+std::vector<std::string> systemIncludeDirectories(const std::string& compiler);
+
+}
+
+#endif
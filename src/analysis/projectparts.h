@@ -0,0 +1,63 @@
+#ifndef ANALYSIS_PROJECTPARTS_H
+#define ANALYSIS_PROJECTPARTS_H
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "../projectmodel.h"
+
+class ThreadPool;
+
+namespace file_utils {
+class BatchIo;
+}
+
+namespace analysis {
+
+class IncludeScanner;
+
+struct ProjectPartOptions {
+  // the source bytes one part may hold, projects with fewer bytes aren't split
+  unsigned long long partBytes = 2 * 1024 * 1024;
+};
+
+// Sources of a project compiled as an object library of their own and linked into the project's target.
+struct ProjectPart {
+  // derived from the directory the sources share, the library is called <target>_<name>
+  std::string name;
+  // relative to the project as "./dir/file"
+  std::vector<std::string> sources;
+  unsigned long long bytes;
+};
+
+// Splits the sources of projects larger than partBytes along their directories. A directory that
+// fits into the budget becomes one piece, larger ones are split into their subdirectories and their
+// own files. Pieces of less than half the budget are merged with the piece they share the most
+// includes with, preferring the nearest directory. The piece holding the project's top level files,
+// or its main source, stays with the target and every other piece becomes a part.
+std::vector<std::vector<ProjectPart>> planProjectParts(
+  const std::vector<ProjectModel>& projects,
+  const ProjectPartOptions& options,
+  IncludeScanner& scanner,
+  file_utils::BatchIo& io,
+  const ThreadPool& pool
+);
+
+// The sources of all parts, which the target's own source list leaves out.
+std::unordered_set<std::string> partSources(const std::vector<ProjectPart>& parts);
+
+// The CMakeLists.txt section holding the parts.
+extern const std::string ProjectPartsSection;
+
+// The parts written into the section of a CMakeLists.txt before, without their sizes.
+std::vector<ProjectPart> parseProjectParts(std::string_view contents, const std::string& target);
+
+// The body of that section for a target. The parts take over the target's include directories,
+// definitions, options, features and links through generator expressions, cmake before 3.12 can't
+// link object libraries and compiles their sources in the target. Empty without parts.
+std::string renderProjectParts(const std::string& target, const std::vector<ProjectPart>& parts);
+
+}
+
+#endif
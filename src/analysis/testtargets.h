@@ -0,0 +1,90 @@
+#ifndef ANALYSIS_TESTTARGETS_H
+#define ANALYSIS_TESTTARGETS_H
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "../projectmodel.h"
+
+class ThreadPool;
+
+namespace file_utils {
+class BatchIo;
+}
+
+namespace analysis {
+
+struct TestOptions {
+  // globs on paths relative to the root without the leading ./, a source matching one is a test
+  std::vector<std::string> patterns = {
+    "**/*_test.*", "**/*_tests.*", "**/test_*.*", "**/*Test.*", "**/*Tests.*", "**/test/**", "**/tests/**"
+  };
+  // the tests of sources matching the glob take the resource lock, ctest doesn't run them at the same time
+  std::vector<std::pair<std::string, std::string>> resourceLocks;
+  // the tests of sources matching the glob count as using that many processors, the first match wins
+  std::vector<std::pair<std::string, unsigned int>> processors;
+  // how much of a test source is searched for its framework and main()
+  unsigned long long prefixBytes = 16 * 1024;
+};
+
+enum class TestFramework { None, GoogleTest, Catch2 };
+
+// One test source built into an executable of its own, so ctest -j can run them side by side.
+struct TestTarget {
+  // derived from the file name, the executable and test are called <target>_<name>
+  std::string name;
+  // relative to the project as "./dir/file", the test source first and the helper sources after it
+  std::vector<std::string> sources;
+  TestFramework framework;
+  bool definesMain;
+  std::vector<std::string> resourceLocks;
+  // 0 leaves PROCESSORS unset
+  unsigned int processors;
+};
+
+// The test sources of every project. A test source that includes Google Test or Catch2 or
+// defines main() becomes a test, the other test sources of the project are helpers compiled
+// into all of its tests. Projects with helpers only and projects of test sources only get no tests.
+std::vector<std::vector<TestTarget>> planTests(
+  const std::vector<ProjectModel>& projects,
+  const TestOptions& options,
+  file_utils::BatchIo& io,
+  const ThreadPool& pool
+);
+
+// Whether a walked source, "./dir/file" relative to the root, matches the test patterns.
+bool isTestSource(const TestOptions& options, std::string_view path);
+
+// The sources of all tests, which the target's own source list leaves out.
+std::unordered_set<std::string> testSources(const std::vector<TestTarget>& tests);
+
+// The names of the executables of a target's tests, in the order of the tests.
+std::vector<std::string> testExecutables(const std::string& target, const std::vector<TestTarget>& tests);
+
+// The CMakeLists.txt section holding a project's tests.
+extern const std::string TestsSection;
+
+// The section of the top level CMakeLists.txt that turns testing on for the whole tree.
+extern const std::string TestingSection;
+
+// The sources of the tests written into the section of a CMakeLists.txt before.
+std::unordered_set<std::string> parseTestSources(std::string_view contents);
+
+// The executables of the tests written into the section of a CMakeLists.txt before.
+std::vector<std::string> parseTestExecutables(std::string_view contents);
+
+// The tests written into the section of a CMakeLists.txt before, their framework and whether they
+// define main() read from what they link. Resource locks and processors aren't read back.
+std::vector<TestTarget> parseTests(std::string_view contents, const std::string& target);
+
+// The body of the tests section for a target. Tests take over the target's include directories,
+// definitions, options and features, and link the target when it is a library or its links
+// otherwise. Google Test and Catch2 tests register every test case with ctest on their own.
+// Empty without tests.
+std::string renderTests(const std::string& target, bool linkTarget, const std::vector<TestTarget>& tests);
+
+}
+
+#endif
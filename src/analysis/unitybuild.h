@@ -0,0 +1,56 @@
+#ifndef ANALYSIS_UNITYBUILD_H
+#define ANALYSIS_UNITYBUILD_H
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../projectmodel.h"
+
+class ThreadPool;
+
+namespace file_utils {
+class BatchIo;
+}
+
+namespace analysis {
+
+struct UnityBuildOptions {
+  // the number of source bytes one unity file aims for, batches stay between half and twice of it
+  unsigned long long batchBytes = 128 * 1024;
+};
+
+struct UnityGroup {
+  // derived from the first source, so a group keeps its name and unity file while its first source stays
+  std::string name;
+  // relative to the project as "./dir/file"
+  std::vector<std::string> sources;
+  unsigned long long bytes;
+};
+
+// Splits the sources of every project into unity groups of about batchBytes each. The sources are
+// taken in path order and a group ends after a source when a hash of its path says so, with a
+// likelihood growing with the size of the source. Adding or removing a source therefore only
+// changes the group it lands in, the others keep their sources and names. Sources that define a
+// name with internal linkage another source of the group defines too start a new group.
+// Groups of a single source aren't returned, those sources are compiled on their own.
+std::vector<std::vector<UnityGroup>> planUnityBuilds(
+  const std::vector<ProjectModel>& projects,
+  const UnityBuildOptions& options,
+  file_utils::BatchIo& io,
+  const ThreadPool& pool
+);
+
+// Names a source defines that clash when it is compiled together with another source defining them:
+// static and const declarations at namespace scope, everything in anonymous namespaces and macros.
+// Found with a token scan that doesn't preprocess, so it is a close guess.
+std::vector<std::string> internalNames(std::string_view source);
+
+// The CMakeLists.txt section holding the groups.
+extern const std::string UnityBuildSection;
+
+// The body of that section for a target, guarded for cmake versions before 3.18. Empty without groups.
+std::string renderUnityBuild(const std::string& target, const std::vector<UnityGroup>& groups);
+
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef BUILDREPORT_H
+#define BUILDREPORT_H
+#include <string>
+#include <vector>
+
+#include "file_utils/batchio.h"
+
+// An edge ninja finished, times are in milliseconds since the start of its build.
+struct NinjaLogEntry {
+  unsigned long long start;
+  unsigned long long end;
+  std::string output;
+};
+
+// Where the time of one ninja build went, read from the lines it appended to .ninja_log.
+class BuildReport {
+public:
+  // Ninja only appends to the log, so the entries of the next build start at the current end of it.
+  // When ninja recompacts the log it is replaced by a new file, which mixes earlier builds in, and no report is made.
+  static BuildReport readNinjaLog(const std::string& path, const file_utils::FileStatus& before);
+
+  std::vector<std::string> describe(size_t top, unsigned int jobs) const;
+
+private:
+  BuildReport(std::vector<NinjaLogEntry> entries, bool rewritten);
+
+  std::vector<NinjaLogEntry> entries_;
+  bool rewritten_;
+};
+
+#endif
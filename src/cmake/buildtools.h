@@ -0,0 +1,28 @@
+#ifndef CMAKE_BUILDTOOLS_H
+#define CMAKE_BUILDTOOLS_H
+#include <string>
+
+namespace cmake {
+
+// Programs on this machine that make builds faster, empty when none was found.
+struct BuildTools {
+  // ccache or sccache, every compile goes through it
+  std::string launcher;
+  // mold or lld, given to the compiler as -fuse-ld=
+  std::string linker;
+};
+
+// Looks for the tools in the directories of $PATH, the first one found of each kind is taken.
+BuildTools findBuildTools();
+
+// The top level CMakeLists.txt section holding the tools, placed before the projects are added.
+extern const std::string BuildToolsSection;
+
+// The body of that section. Each part is behind an option that is on by default, a linker the
+// compiler can't use is left out when configuring. Optimized builds drop unused code when linking
+// and Debug builds keep their debug information out of the objects.
+std::string renderBuildTools(const BuildTools& tools);
+
+}
+
+#endif
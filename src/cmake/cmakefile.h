@@ -4,6 +4,7 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class IoHandler;
@@ -16,6 +17,7 @@ class ICmakeFunctionCriteria;
 class CmakeFile {
 public:
   static std::shared_ptr<CmakeFile> parse(const std::string& directoryPath, const std::string& filePath, IoHandler& ioHandler);
+  static std::shared_ptr<CmakeFile> parseContents(const std::string& directoryPath, std::string_view contents, IoHandler& ioHandler);
 
   CmakeFile(const std::string& path);
 
@@ -26,20 +28,21 @@ public:
   CmakeFunction* getFunction(const ICmakeFunctionCriteria& criteria) const;
 
   void addFunction(const std::shared_ptr<CmakeFunction>& func);
-  void replaceIncludeFiles(const std::vector<std::string>& includeFiles);
-  void replaceSourceFiles(const std::vector<std::string>& sourceFiles);
+  void replaceIncludeFiles(const std::vector<std::string_view>& includeFiles);
+  void replaceSourceFiles(const std::vector<std::string_view>& sourceFiles);
   void removeIncludeFiles();
+  std::string render();
   void write();
 
 private:
   static std::shared_ptr<CmakeFunction> parseFunction(const Token& parentToken, CmakeScanner& scanner);
-  void addIncludeFunction(const std::vector<std::string>& includeFiles);
+  void addIncludeFunction(const std::vector<std::string_view>& includeFiles);
   void moveFunctions(std::vector<std::shared_ptr<CmakeFunction>>::iterator startItr, const int lineOffset);
   std::shared_ptr<CmakeFunction> createReplacementFunction(
     const std::string& functionName,
     const std::string& setArgumentName,
     const FilePosition& startPosition,
-    const std::vector<std::string>& files
+    const std::vector<std::string_view>& files
   );
 
   std::string path_;
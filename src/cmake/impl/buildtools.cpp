@@ -0,0 +1,81 @@
+#include "../buildtools.h"
+#include "../managedsection.h"
+#include "../../file_utils/fileutils.h"
+
+#include <utility>
+#include <vector>
+
+namespace cmake {
+
+const std::string BuildToolsSection = "build tools";
+
+namespace {
+  const std::string GnuOrClang = "CMAKE_CXX_COMPILER_ID MATCHES \"GNU|Clang\"";
+
+  // the name to look for and the name cmake is given
+  std::string findFirst(const std::vector<std::pair<std::string, std::string>>& programs) {
+    for (const auto& [program, name] : programs) {
+      if (!file_utils::findProgram(program).empty()) {
+        return name;
+      }
+    }
+    return "";
+  }
+
+  std::string appendFlags(const std::string& variable, const std::string& flags) {
+    return renderFunction("set", {variable, "\"${" + variable + "} " + flags + "\""});
+  }
+}
+
+BuildTools findBuildTools() {
+  BuildTools tools;
+  tools.launcher = findFirst({{"ccache", "ccache"}, {"sccache", "sccache"}});
+  // -fuse-ld=lld looks for ld.lld
+  tools.linker = findFirst({{"mold", "mold"}, {"ld.lld", "lld"}});
+  return tools;
+}
+
+std::string renderBuildTools(const BuildTools& tools) {
+  std::string body = "";
+  if (!tools.launcher.empty()) {
+    body += renderFunction("option", {"CMAKEGEN_LAUNCHER", "\"Compile through " + tools.launcher + "\"", "ON"});
+    body += "if(CMAKEGEN_LAUNCHER)\n";
+    body += "  " + renderFunction("find_program", {"CMAKEGEN_LAUNCHER_PROGRAM", tools.launcher});
+    body += "  if(CMAKEGEN_LAUNCHER_PROGRAM)\n";
+    body += "    " + renderFunction("set", {"CMAKE_CXX_COMPILER_LAUNCHER", "${CMAKEGEN_LAUNCHER_PROGRAM}"});
+    body += "  endif()\n";
+    body += "endif()\n";
+  }
+
+  if (!tools.linker.empty()) {
+    // the compiler runs the linker it would use for --version, so one it can't find is left out
+    body += renderFunction("option", {"CMAKEGEN_FAST_LINKER", "\"Link with " + tools.linker + "\"", "ON"});
+    body += "if(CMAKEGEN_FAST_LINKER AND " + GnuOrClang + ")\n";
+    body += "  " + renderFunction("execute_process", {
+      "COMMAND", "${CMAKE_CXX_COMPILER}", "-fuse-ld=" + tools.linker, "-Wl,--version",
+      "RESULT_VARIABLE", "linkerResult", "OUTPUT_QUIET", "ERROR_QUIET"
+    });
+    body += "  if(linkerResult EQUAL 0)\n";
+    body += "    " + appendFlags("CMAKE_EXE_LINKER_FLAGS", "-fuse-ld=" + tools.linker);
+    body += "    " + appendFlags("CMAKE_SHARED_LINKER_FLAGS", "-fuse-ld=" + tools.linker);
+    body += "  endif()\n";
+    body += "endif()\n";
+  }
+
+  body += renderFunction("option", {"CMAKEGEN_GC_SECTIONS", "\"Drop unused functions and data when linking optimized builds\"", "ON"});
+  body += "if(CMAKEGEN_GC_SECTIONS AND " + GnuOrClang + " AND NOT APPLE)\n";
+  body += "  foreach(config RELEASE MINSIZEREL RELWITHDEBINFO)\n";
+  body += "    " + appendFlags("CMAKE_CXX_FLAGS_${config}", "-ffunction-sections -fdata-sections");
+  body += "    " + appendFlags("CMAKE_EXE_LINKER_FLAGS_${config}", "-Wl,--gc-sections");
+  body += "    " + appendFlags("CMAKE_SHARED_LINKER_FLAGS_${config}", "-Wl,--gc-sections");
+  body += "  endforeach()\n";
+  body += "endif()\n";
+
+  body += renderFunction("option", {"CMAKEGEN_SPLIT_DWARF", "\"Keep the debug information of Debug builds out of the objects\"", "ON"});
+  body += "if(CMAKEGEN_SPLIT_DWARF AND " + GnuOrClang + " AND NOT APPLE)\n";
+  body += "  " + appendFlags("CMAKE_CXX_FLAGS_DEBUG", "-gsplit-dwarf");
+  body += "endif()\n";
+  return body;
+}
+
+}
@@ -1,6 +1,7 @@
 #include "../cmakefile.h"
 #include "cmakescanner.h"
 #include "cmakeformatter.h"
+#include "../../file_utils/batchio.h"
 #include "../../file_utils/fileutils.h"
 #include "../../iohandler.h"
 #include "../cmakefunctioncriteria.h"
@@ -17,7 +18,12 @@ namespace {
 }
 
 std::shared_ptr<CmakeFile> CmakeFile::parse(const std::string& directoryPath, const std::string& filePath, IoHandler& ioHandler) {
-  CmakeScanner scanner(filePath);
+  const auto contents = file_utils::SyncBatchIo::readFile(filePath);
+  return parseContents(directoryPath, contents.data, ioHandler);
+}
+
+std::shared_ptr<CmakeFile> CmakeFile::parseContents(const std::string& directoryPath, std::string_view contents, IoHandler& ioHandler) {
+  CmakeScanner scanner(contents);
 
   Token token = { TokenType::NONE, "", 0, 0, 0 };
   bool hasEncounteredNewline = true;
@@ -92,7 +98,7 @@ void CmakeFile::addFunction(const std::shared_ptr<CmakeFunction>& func) {
   functions_.push_back(func);
 }
 
-void CmakeFile::replaceIncludeFiles(const std::vector<std::string>& includeFiles) {
+void CmakeFile::replaceIncludeFiles(const std::vector<std::string_view>& includeFiles) {
   const auto includeFileCriteria = CmakeSetFileFunctionCriteria(CmakeSetFileFunctionCriteria::IncludeFiles);
   const auto* includeFileFunction = getFunction(includeFileCriteria);
   if (!includeFileFunction) {
@@ -119,7 +125,7 @@ void CmakeFile::replaceIncludeFiles(const std::vector<std::string>& includeFiles
   moveFunctions(itr + 1, lineOffset);
 }
 
-void CmakeFile::replaceSourceFiles(const std::vector<std::string>& sourceFiles) {
+void CmakeFile::replaceSourceFiles(const std::vector<std::string_view>& sourceFiles) {
   const auto sourceFileCriteria = CmakeSetFileFunctionCriteria(CmakeSetFileFunctionCriteria::SourceFiles);
   const auto* sourceFileFunction = getFunction(sourceFileCriteria);
   if (!sourceFileFunction) {
@@ -165,22 +171,27 @@ void CmakeFile::removeIncludeFiles() {
   outputFunc->removeArgument(constants::SetIncludeFilesOutputArgument);
 }
 
+std::string CmakeFile::render() {
+  std::ostringstream stream;
+  CmakeFormatter formatter;
+  formatter.format(stream, *this);
+  return stream.str();
+}
+
 void CmakeFile::write() {
   std::ofstream stream(path_ + "/" + constants::FileName);
   if (!stream.is_open()) {
     return;
   }
 
-  CmakeFormatter formatter;
-  formatter.format(stream, *this);
-
+  stream << render();
   stream.close();
 }
 
 std::shared_ptr<CmakeFunction> CmakeFile::parseFunction(const Token& parentToken, CmakeScanner& scanner) {
   Token token = { TokenType::NONE, "", 0, 0, 0 };
   std::vector<CmakeFunctionArgument> arguments = {};
-  while (token.type != TokenType::PARENRIGHT) {
+  while (token.type != TokenType::PARENRIGHT && token.type != TokenType::ENDOFFILE) {
     token = scanner.getNextToken();
     switch(token.type) {
       case TokenType::IDENTIFIER:
@@ -199,7 +210,7 @@ std::shared_ptr<CmakeFunction> CmakeFile::parseFunction(const Token& parentToken
   return CmakeFunction::create(parentToken.text, arguments, {parentToken.line, parentToken.column}, {token.line, token.column});
 }
 
-void CmakeFile::addIncludeFunction(const std::vector<std::string>& includeFiles) {
+void CmakeFile::addIncludeFunction(const std::vector<std::string_view>& includeFiles) {
   const auto srcFileCriteria = CmakeSetFileFunctionCriteria(CmakeSetFileFunctionCriteria::SourceFiles);
   const auto* srcFileFunction = getFunction(srcFileCriteria);
 
@@ -235,7 +246,7 @@ std::shared_ptr<CmakeFunction> CmakeFile::createReplacementFunction(
   const std::string& functionName,
   const std::string& setArgumentName,
   const FilePosition& startPosition,
-  const std::vector<std::string>& files
+  const std::vector<std::string_view>& files
 ) {
   unsigned int line = startPosition.line_ + 1;
   std::vector<CmakeFunctionArgument> arguments = {{setArgumentName, startPosition, false}};
@@ -1,6 +1,5 @@
 #include "cmakescanner.h"
 
-#include <algorithm>
 #include <functional>
 #include <vector>
 #include <sstream>
@@ -9,60 +8,28 @@
 namespace cmake {
 
 namespace {
-  char nextCharacter(std::ifstream& file) {
-    char c;
-    file.get(c);
-    return c;
-  }
-
-  const std::vector<char> argumentCharacters = {'.', '_', '\\', '/', '$', '{', '}', ':', '-', '"', '+', '|', '='};
+  // an unquoted argument ends at whitespace or a parenthesis, flags like -checks=-*,readability-* are one argument
   bool allowedInArgument(char c) {
-    bool specialCharacter = std::any_of(argumentCharacters.begin(), argumentCharacters.end(), [c](char argumentCharacter){
-      return c == argumentCharacter;
-    });
-
-    return specialCharacter || isalnum(c);
+    return c != ' ' && c != '\n' && c != '\t' && c != '\r' && c != '(' && c != ')';
   }
 
   bool allowedInIdentifier(char c) {
     return c == '_' || isalnum(c);
   }
-
-  struct AllowedCharactersResult {
-    char nextCharacter;
-    std::string processedCharacters;
-  };
-  AllowedCharactersResult getAllowedCharacters(std::ifstream& file, char firstCharacter, std::function<bool(char)> predicate) {
-    char c = firstCharacter;
-    std::stringstream s;
-    while(predicate(c)) {
-      s << c;
-      c = nextCharacter(file);
-    }
-
-    return { c, s.str() };
-  }
 }
 
-CmakeScanner::CmakeScanner(const std::string& filePath)
-  : currentLine_(1), currentColumn_(1), lastChar_(0), scanningArguments_(false), file_(filePath) {
-}
-
-CmakeScanner::~CmakeScanner() {
-  file_.close();
+CmakeScanner::CmakeScanner(std::string_view contents)
+  : currentLine_(1), currentColumn_(1), lastChar_(0), scanningArguments_(false),
+  cursor_(contents.data()), end_(contents.data() + contents.size()), eof_(false) {
 }
 
 Token CmakeScanner::getNextToken() {
-  if (!file_.is_open()) {
-    return { TokenType::ENDOFFILE, "", 0, currentLine_, currentColumn_ };
-  }
-
-  char c = lastChar_ ? lastChar_ : nextCharacter(file_);
+  char c = lastChar_ ? lastChar_ : nextCharacter();
   if (lastChar_) {
     lastChar_ = 0;
   }
 
-  if (file_.eof()) {
+  if (eof_) {
     return {TokenType::ENDOFFILE, "", 0, currentLine_, currentColumn_};
   }
 
@@ -102,6 +69,27 @@ Token CmakeScanner::getNextToken() {
   return { TokenType::BADCHARACTER, std::string(1, c), 0, currentLine_, currentColumn_++ };
 }
 
+char CmakeScanner::nextCharacter() {
+  if (cursor_ == end_) {
+    eof_ = true;
+    return 0;
+  }
+  return *cursor_++;
+}
+
+// Collects characters as long as the predicate holds, the first rejected character is left in lastChar_.
+std::string CmakeScanner::getAllowedCharacters(char firstCharacter, const std::function<bool(char)>& predicate) {
+  char c = firstCharacter;
+  std::string characters;
+  while(!eof_ && predicate(c)) {
+    characters += c;
+    c = nextCharacter();
+  }
+
+  lastChar_ = c;
+  return characters;
+}
+
 Token CmakeScanner::getComment() {
   bool multiLine = false;
   char c = '#';
@@ -109,11 +97,11 @@ Token CmakeScanner::getComment() {
   s << c;
 
   char previous = c;
-  c = nextCharacter(file_);
+  c = nextCharacter();
 
   int commentLines = 0;
   int commentColumns = 1;
-  while ((multiLine || c != '\n') && (!multiLine || (c != ']' || previous != ']'))) {
+  while (!eof_ && (multiLine || c != '\n') && (!multiLine || (c != ']' || previous != ']'))) {
     if (c == '[' && previous == '[') {
       multiLine = true;
     }
@@ -123,11 +111,11 @@ Token CmakeScanner::getComment() {
     }
     s << c;
     previous = c;
-    c = nextCharacter(file_);
+    c = nextCharacter();
     commentColumns++;
   }
 
-  if (multiLine) {
+  if (multiLine && !eof_) {
     s << c;
     commentColumns++;
   }
@@ -145,15 +133,18 @@ Token CmakeScanner::getComment() {
 
 Token CmakeScanner::getArgument(char c) {
   bool quoted = (c == '"');
-  const auto result = getAllowedCharacters(file_, c, allowedInArgument);
-  const unsigned int noOfCharactersProcessed = result.processedCharacters.size();
+  const auto characters = getAllowedCharacters(c, allowedInArgument);
+  if (characters.empty()) {
+    lastChar_ = 0;
+    return { TokenType::BADCHARACTER, std::string(1, c), 0, currentLine_, currentColumn_++ };
+  }
+  const unsigned int noOfCharactersProcessed = characters.size();
   const auto column = currentColumn_;
 
-  lastChar_ = result.nextCharacter;
   currentColumn_ += noOfCharactersProcessed;
   return {
     quoted ? TokenType::ARGUMENTQUOTED : TokenType::ARGUMENTUNQUOTED,
-    result.processedCharacters,
+    characters,
     noOfCharactersProcessed,
     currentLine_,
     column
@@ -161,16 +152,15 @@ Token CmakeScanner::getArgument(char c) {
 }
 
 Token CmakeScanner::getIdentifier(char c) {
-  const auto result = getAllowedCharacters(file_, c, allowedInIdentifier);
-  const unsigned int noOfCharactersProcessed = result.processedCharacters.size();
+  const auto characters = getAllowedCharacters(c, allowedInIdentifier);
+  const unsigned int noOfCharactersProcessed = characters.size();
   const auto column = currentColumn_;
 
-  lastChar_ = result.nextCharacter;
   currentColumn_ += noOfCharactersProcessed;
 
   return {
     TokenType::IDENTIFIER,
-    result.processedCharacters,
+    characters,
     noOfCharactersProcessed,
     currentLine_,
     column
@@ -1,8 +1,9 @@
 #ifndef CMAKE_CMAKESCANNER_H
 #define CMAKE_CMAKESCANNER_H
-#include <fstream>
+#include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
 
 namespace cmake {
 
@@ -33,10 +34,11 @@ struct Token {
 
 class CmakeScanner {
 public:
-  CmakeScanner(const std::string& filePath);
-  ~CmakeScanner();
+  CmakeScanner(std::string_view contents);
   Token getNextToken();
 private:
+  char nextCharacter();
+  std::string getAllowedCharacters(char firstCharacter, const std::function<bool(char)>& predicate);
   Token getComment();
   Token getArgument(char c);
   Token getIdentifier(char c);
@@ -45,7 +47,9 @@ private:
   unsigned int currentColumn_;
   char lastChar_;
   bool scanningArguments_;
-  std::ifstream file_;
+  const char* cursor_;
+  const char* end_;
+  bool eof_;
 };
 
 }
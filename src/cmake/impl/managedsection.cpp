@@ -0,0 +1,122 @@
+#include "../managedsection.h"
+
+#include <algorithm>
+
+namespace cmake {
+namespace {
+  const std::string Marker = "# cmakegen: ";
+
+  // The offset of the line holding exactly text, npos when there is none.
+  size_t findLine(std::string_view contents, const std::string& text) {
+    for (auto position = contents.find(text); position != std::string_view::npos; position = contents.find(text, position + 1)) {
+      const auto end = position + text.size();
+      const bool startsLine = position == 0 || contents[position - 1] == '\n';
+      const bool endsLine = end == contents.size() || contents[end] == '\n' || contents[end] == '\r';
+      if (startsLine && endsLine) {
+        return position;
+      }
+    }
+    return std::string_view::npos;
+  }
+
+  // The offset just past the line that ends the first call of function, npos when there is none.
+  size_t findFunctionEnd(std::string_view contents, const std::string& function) {
+    size_t lineStart = 0;
+    while (lineStart < contents.size()) {
+      const auto lineEnd = contents.find('\n', lineStart);
+      const auto line = contents.substr(lineStart, lineEnd == std::string_view::npos ? std::string_view::npos : lineEnd - lineStart);
+      const auto name = line.find_first_not_of(" \t");
+      if (name != std::string_view::npos && line.compare(name, function.size(), function) == 0) {
+        const auto open = line.find_first_not_of(" \t", name + function.size());
+        if (open != std::string_view::npos && line[open] == '(') {
+          // arguments can span lines, the call ends with the parenthesis that closes the first one
+          int depth = 0;
+          for (auto position = lineStart + open; position < contents.size(); position++) {
+            depth += contents[position] == '(' ? 1 : contents[position] == ')' ? -1 : 0;
+            if (depth == 0) {
+              const auto end = contents.find('\n', position);
+              return end == std::string_view::npos ? contents.size() : end + 1;
+            }
+          }
+          return std::string_view::npos;
+        }
+      }
+      if (lineEnd == std::string_view::npos) {
+        break;
+      }
+      lineStart = lineEnd + 1;
+    }
+    return std::string_view::npos;
+  }
+}
+
+std::string replaceManagedSection(
+  std::string_view contents,
+  const std::string& name,
+  const std::string& body,
+  const std::string& after
+) {
+  const auto begin = findLine(contents, Marker + name);
+  const auto endMarker = Marker + "end " + name;
+  const auto end = begin == std::string_view::npos ? std::string_view::npos : findLine(contents.substr(begin), endMarker);
+  const auto section = body.empty() ? std::string() : Marker + name + "\n" + body + endMarker + "\n";
+
+  if (end == std::string_view::npos) {
+    if (section.empty()) {
+      return std::string(contents);
+    }
+
+    const auto callEnd = after.empty() ? std::string_view::npos : findFunctionEnd(contents, after);
+    if (callEnd != std::string_view::npos) {
+      auto rest = contents.substr(callEnd);
+      while (!rest.empty() && (rest.front() == '\n' || rest.front() == '\r')) {
+        rest.remove_prefix(1);
+      }
+      const auto head = std::string(contents.substr(0, callEnd));
+      return head + (head.back() == '\n' ? "\n" : "\n\n") + section + (rest.empty() ? "" : "\n") + std::string(rest);
+    }
+
+    // appended after a single blank line, however many the file ended with
+    auto kept = contents;
+    while (!kept.empty() && (kept.back() == '\n' || kept.back() == '\r')) {
+      kept.remove_suffix(1);
+    }
+    return std::string(kept) + (kept.empty() ? "" : "\n\n") + section;
+  }
+
+  auto sectionEnd = begin + end + endMarker.size();
+  while (sectionEnd < contents.size() && contents[sectionEnd] != '\n') {
+    sectionEnd++;
+  }
+  sectionEnd = std::min(sectionEnd + 1, contents.size());
+
+  auto sectionStart = begin;
+  if (section.empty()) {
+    // the blank line that separated the section goes with it
+    if (sectionStart >= 2 && contents[sectionStart - 1] == '\n' && contents[sectionStart - 2] == '\n') {
+      sectionStart--;
+    }
+  }
+  return std::string(contents.substr(0, sectionStart)) + section + std::string(contents.substr(sectionEnd));
+}
+
+std::string managedSection(std::string_view contents, const std::string& name) {
+  const auto begin = findLine(contents, Marker + name);
+  const auto lineEnd = begin == std::string_view::npos ? begin : contents.find('\n', begin);
+  if (lineEnd == std::string_view::npos) {
+    return "";
+  }
+  const auto bodyStart = lineEnd + 1;
+  const auto end = findLine(contents.substr(bodyStart), Marker + "end " + name);
+  return end == std::string_view::npos ? "" : std::string(contents.substr(bodyStart, end));
+}
+
+std::string renderFunction(const std::string& name, const std::vector<std::string>& arguments) {
+  std::string line = name + "(";
+  for (size_t i = 0; i < arguments.size(); i++) {
+    line += (i == 0 ? "" : " ") + arguments[i];
+  }
+  return line + ")\n";
+}
+
+}
@@ -0,0 +1,82 @@
+#include "../releaseprofile.h"
+#include "../managedsection.h"
+
+#include <vector>
+
+namespace cmake {
+
+const std::string ReleaseProfileSection = "release profile";
+
+bool parseReleaseProfile(const std::string& name, ReleaseProfile& profile) {
+  if (name != "release" && name != "default") {
+    return false;
+  }
+  profile.optimize = name == "release";
+  return true;
+}
+
+bool readReleaseProfile(std::string_view contents, ReleaseProfile& profile) {
+  const auto body = managedSection(contents, ReleaseProfileSection);
+  if (body.empty()) {
+    return false;
+  }
+
+  profile.optimize = body.find("check_ipo_supported") != std::string::npos;
+  const auto march = body.find("-march=");
+  if (march != std::string::npos) {
+    const auto start = march + 7;
+    profile.architecture = body.substr(start, body.find_first_of(" )\n", start) - start);
+  }
+  return true;
+}
+
+std::string renderReleaseProfile(const std::string& target, const ReleaseProfile& profile, const std::vector<std::string>& compiledAlike) {
+  if (!profile.optimize && profile.architecture.empty()) {
+    return "";
+  }
+
+  std::string body = "";
+  if (profile.optimize) {
+    // the check compiles a test project, the result is kept in the cache for every other target
+    body += renderFunction("include", {"CheckIPOSupported"});
+    body += "if(NOT DEFINED CMAKEGEN_IPO_SUPPORTED)\n";
+    body += "  " + renderFunction("check_ipo_supported", {"RESULT", "ipoSupported", "LANGUAGES", "CXX"});
+    body += "  " + renderFunction("set", {"CMAKEGEN_IPO_SUPPORTED", "${ipoSupported}", "CACHE", "INTERNAL", "\"\""});
+    body += "endif()\n";
+    body += "if(CMAKEGEN_IPO_SUPPORTED)\n";
+    body += "  " + renderFunction("set_target_properties", {target, "PROPERTIES", "INTERPROCEDURAL_OPTIMIZATION_RELEASE", "ON"});
+    body += "endif()\n";
+    body += renderFunction("set", {"PGO", "\"\"", "CACHE", "STRING", "\"Profile guided optimization, generate or use\""});
+    body += renderFunction("set", {"PGO_DIRECTORY", "\"${CMAKE_BINARY_DIR}/pgo\"", "CACHE", "PATH", "\"Where PGO=generate writes profiles and PGO=use reads them\""});
+  }
+
+  body += "if(CMAKE_CXX_COMPILER_ID MATCHES \"GNU|Clang\")\n";
+  if (!profile.architecture.empty()) {
+    body += "  " + renderFunction("target_compile_options", {target, "PRIVATE", "-march=" + profile.architecture});
+  }
+  if (profile.optimize) {
+    // executables compiled with the target's options are instrumented as well and need the same link flags
+    const auto linkFlags = [&target, &compiledAlike](const std::string& flag) {
+      std::vector<std::string> arguments = {"TARGET", target};
+      arguments.insert(arguments.end(), compiledAlike.begin(), compiledAlike.end());
+      arguments.insert(arguments.end(), {"APPEND_STRING", "PROPERTY", "LINK_FLAGS", "\" " + flag + "\""});
+      return renderFunction("set_property", arguments);
+    };
+    // link flags go through LINK_FLAGS, target_link_options needs cmake 3.13 and target_link_libraries
+    // can't be mixed with a call without PUBLIC and PRIVATE elsewhere in the file
+    body += "  if(PGO STREQUAL \"generate\")\n";
+    body += "    " + renderFunction("target_compile_options", {target, "PRIVATE", "-fprofile-generate=${PGO_DIRECTORY}"});
+    body += "    " + linkFlags("-fprofile-generate=${PGO_DIRECTORY}");
+    body += "  elseif(PGO STREQUAL \"use\")\n";
+    // gcc warns about sources the training run didn't reach and about counters threads raced on
+    body += "    " + renderFunction("target_compile_options", {
+      target, "PRIVATE", "-fprofile-use=${PGO_DIRECTORY}",
+      "$<$<CXX_COMPILER_ID:GNU>:-fprofile-correction>", "$<$<CXX_COMPILER_ID:GNU>:-Wno-missing-profile>"
+    });
+    body += "    " + linkFlags("-fprofile-use=${PGO_DIRECTORY}");
+    body += "  endif()\n";
+  }
+  return body + "endif()\n";
+}
+
+}
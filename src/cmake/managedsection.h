@@ -0,0 +1,30 @@
+#ifndef CMAKE_MANAGEDSECTION_H
+#define CMAKE_MANAGEDSECTION_H
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cmake {
+
+// Blocks of a CMakeLists.txt that cmakegen owns, the lines between "# cmakegen: <name>" and
+// "# cmakegen: end <name>". They are rewritten as a whole, everything around them is left as it is.
+
+// Replaces the lines of the section with body, appends the section at the end of the file when it
+// is missing and removes it when body is empty. Body is given as whole lines. A missing section goes
+// after the first call of the function named after instead when the file has one.
+std::string replaceManagedSection(
+  std::string_view contents,
+  const std::string& name,
+  const std::string& body,
+  const std::string& after = ""
+);
+
+// The body of the section, empty when the file has none.
+std::string managedSection(std::string_view contents, const std::string& name);
+
+// A function call on one line, the way sections are written.
+std::string renderFunction(const std::string& name, const std::vector<std::string>& arguments);
+
+}
+
+#endif
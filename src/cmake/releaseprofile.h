@@ -0,0 +1,33 @@
+#ifndef CMAKE_RELEASEPROFILE_H
+#define CMAKE_RELEASEPROFILE_H
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cmake {
+
+// What the release profile section of a target asks the compiler for.
+struct ReleaseProfile {
+  // interprocedural optimization for Release builds, when the compiler supports it, and the PGO cache options
+  bool optimize = false;
+  // passed as -march= to every build of the target when not empty
+  std::string architecture;
+};
+
+// Sets profile from a --profile name, release or default. Returns false for any other name.
+bool parseReleaseProfile(const std::string& name, ReleaseProfile& profile);
+
+// The CMakeLists.txt section holding the profile.
+extern const std::string ReleaseProfileSection;
+
+// Sets profile from the section a CMakeLists.txt holds. Returns false when it has none.
+bool readReleaseProfile(std::string_view contents, ReleaseProfile& profile);
+
+// The body of that section for a target, empty when the profile asks for nothing. Configuring with
+// -DPGO=generate builds the target to write profiles to PGO_DIRECTORY and -DPGO=use builds it from them.
+// The PGO link flags also go to the executables that are compiled with the target's options, its tests.
+std::string renderReleaseProfile(const std::string& target, const ReleaseProfile& profile, const std::vector<std::string>& compiledAlike = {});
+
+}
+
+#endif
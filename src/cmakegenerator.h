@@ -2,31 +2,96 @@
 #define CMAKEGENERATOR_H
 #include <memory>
 #include <string>
+#include <vector>
+
+#include "analysis/dependencygraph.h"
+#include "analysis/precompiledheaders.h"
+#include "analysis/projectparts.h"
+#include "analysis/testtargets.h"
+#include "analysis/unitybuild.h"
+#include "cmake/buildtools.h"
+#include "cmake/releaseprofile.h"
+#include "file_utils/fileutils.h"
+#include "file_utils/patharena.h"
+#include "projectdetection.h"
 
 namespace file_utils {
 class IgnoreFile;
 class Directory;
 }
 
+struct CmakeGeneratorOptions {
+  // the defaults offered by -g and used by -g --batch
+  std::string cmakeVersion = "3.10.0";
+  std::string cppVersion = "cxx_std_11";
+  // how the projects and their types offered as defaults are found
+  ProjectDetectionOptions detection;
+  bool precompileHeaders = false;
+  analysis::PrecompiledHeaderOptions precompiledHeaders;
+  bool unityBuild = false;
+  analysis::UnityBuildOptions unity;
+  cmake::ReleaseProfile releaseProfile;
+  // splits projects with more source bytes than the budget into object libraries
+  bool splitProjects = false;
+  analysis::ProjectPartOptions parts;
+  // builds every test source into an executable of its own registered with ctest
+  bool registerTests = false;
+  analysis::TestOptions tests;
+  // looks for a compiler launcher and a faster linker and sets them up in the top level CMakeLists.txt
+  bool buildTools = true;
+};
+
+class GenerationRules;
 class IoHandler;
 class CmakeGenerator {
 public:
   CmakeGenerator(
     IoHandler& iohandler,
     const file_utils::IgnoreFile& ignoreFile,
-    const std::string& cmakeVersion,
-    const std::string& cppVersion
+    const file_utils::WalkOptions& walkOptions,
+    const CmakeGeneratorOptions& options
   );
   void run();
+  // Generates without asking, the projects and their types come from the rules and the default versions are used.
+  int runBatch(const GenerationRules& rules);
 private:
+  enum ProjectType { Library, Executable };
+
+  // What generating a project needs to know about the others and about what its sources include.
+  struct ProjectAnalysis {
+    analysis::ProjectDependencies dependencies;
+    std::vector<analysis::PrecompiledHeader> precompiledHeaders;
+    std::vector<analysis::UnityGroup> unityGroups;
+    std::vector<analysis::ProjectPart> parts;
+    std::vector<analysis::TestTarget> tests;
+    // turns testing on, set for the top level project when any project has tests
+    bool testing = false;
+  };
+
+  std::shared_ptr<file_utils::Directory> walk();
   void placeInitialCmakeFiles(const std::shared_ptr<file_utils::Directory>& directoryRoot);
   void populateCmakeFiles(const std::shared_ptr<file_utils::Directory>& directoryRoot);
-  void populateCmakeFile(const file_utils::Directory* directory, const std::string& cmakeVersion, const std::string& cppVersion);
+  // Links and include directories between the projects and, when asked for, their precompiled headers, unity groups, parts and tests.
+  std::vector<ProjectAnalysis> analyzeProjects(
+    const std::vector<const file_utils::Directory*>& projects,
+    const std::vector<file_utils::DirectoryFiles>& files,
+    const std::vector<ProjectType>& types
+  );
+  void populateCmakeFile(
+    const file_utils::Directory* directory,
+    const file_utils::DirectoryFiles& files,
+    ProjectType projectType,
+    const ProjectAnalysis& projectAnalysis,
+    const std::string& cmakeVersion,
+    const std::string& cppVersion
+  );
 
-  std::string defaultCmakeVersion_;
-  std::string defaultCppVersion_;
+  CmakeGeneratorOptions options_;
   IoHandler& ioHandler_;
   const file_utils::IgnoreFile& ignoreFile_;
+  file_utils::WalkOptions walkOptions_;
+  file_utils::PathArena paths_;
+  std::vector<const file_utils::Directory*> traversal_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef COMPILATIONDATABASE_H
+#define COMPILATIONDATABASE_H
+#include <string>
+
+#include "file_utils/fileutils.h"
+#include "file_utils/patharena.h"
+
+namespace file_utils {
+class IgnoreFile;
+}
+
+struct ProjectModel;
+
+class IoHandler;
+
+// Writes compile_commands.json straight from the scanned projects, without configuring them first.
+// The commands are the ones cmake would generate for a GNU or Clang compiler, one entry per source file.
+class CompilationDatabase {
+public:
+  CompilationDatabase(
+    IoHandler& ioHandler,
+    const file_utils::IgnoreFile& ignoreFile,
+    const file_utils::WalkOptions& walkOptions,
+    const std::string& cppVersion,
+    bool verbose
+  );
+
+  // The file is only replaced when an entry changed, so tools watching it don't reindex for nothing.
+  int run();
+
+private:
+  // target is the project's own or one of its parts or tests, which are compiled with the project's flags
+  std::string renderEntry(const ProjectModel& project, const std::string& target, const std::string& sourceFile, const std::string& compiler) const;
+
+  IoHandler& ioHandler_;
+  const file_utils::IgnoreFile& ignoreFile_;
+  file_utils::WalkOptions walkOptions_;
+  std::string cppVersion_;
+  bool verbose_;
+  file_utils::PathArena paths_;
+};
+
+#endif
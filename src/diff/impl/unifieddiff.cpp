@@ -0,0 +1,356 @@
+#include "../unifieddiff.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace diff {
+namespace {
+  const int MinimumCost = 256;
+
+  std::vector<std::string_view> splitLines(std::string_view text) {
+    std::vector<std::string_view> lines = {};
+    size_t start = 0;
+    while (start < text.size()) {
+      const auto end = text.find('\n', start);
+      if (end == std::string_view::npos) {
+        lines.push_back(text.substr(start));
+        break;
+      }
+      lines.push_back(text.substr(start, end - start));
+      start = end + 1;
+    }
+    return lines;
+  }
+
+  struct Range {
+    int aLow;
+    int aHigh;
+    int bLow;
+    int bHigh;
+  };
+
+  struct Snake {
+    int x;
+    int y;
+    int u;
+    int v;
+  };
+
+  // Lines are compared as ids, equal lines on either side get the same id.
+  class LineDiff {
+  public:
+    LineDiff(const std::vector<std::string_view>& a, const std::vector<std::string_view>& b)
+      : a_({}), b_({}), removed_(a.size(), false), added_(b.size(), false), forward_({}), backward_({}) {
+      std::unordered_map<std::string_view, int> ids = {};
+      ids.reserve(a.size() + b.size());
+      for (const auto& line : a) {
+        a_.push_back(ids.emplace(line, static_cast<int>(ids.size())).first->second);
+      }
+      for (const auto& line : b) {
+        b_.push_back(ids.emplace(line, static_cast<int>(ids.size())).first->second);
+      }
+    }
+
+    void run() {
+      patience({0, static_cast<int>(a_.size()), 0, static_cast<int>(b_.size())});
+    }
+
+    const std::vector<bool>& removed() const {
+      return removed_;
+    }
+
+    const std::vector<bool>& added() const {
+      return added_;
+    }
+
+  private:
+    // Cuts equal lines off both ends, returns false when nothing is left to compare.
+    bool trim(Range& range) {
+      while (range.aLow < range.aHigh && range.bLow < range.bHigh && a_[range.aLow] == b_[range.bLow]) {
+        range.aLow++;
+        range.bLow++;
+      }
+      while (range.aLow < range.aHigh && range.bLow < range.bHigh && a_[range.aHigh - 1] == b_[range.bHigh - 1]) {
+        range.aHigh--;
+        range.bHigh--;
+      }
+
+      if (range.aLow == range.aHigh || range.bLow == range.bHigh) {
+        std::fill(removed_.begin() + range.aLow, removed_.begin() + range.aHigh, true);
+        std::fill(added_.begin() + range.bLow, added_.begin() + range.bHigh, true);
+        return false;
+      }
+      return true;
+    }
+
+    void patience(Range range) {
+      if (!trim(range)) {
+        return;
+      }
+
+      // lines that occur exactly once on each side, in the order they appear in a
+      struct Occurrence {
+        int countA;
+        int countB;
+        int positionB;
+      };
+      std::unordered_map<int, Occurrence> occurrences = {};
+      for (int i = range.aLow; i < range.aHigh; i++) {
+        occurrences[a_[i]].countA++;
+      }
+      bool shared = false;
+      for (int j = range.bLow; j < range.bHigh; j++) {
+        auto found = occurrences.find(b_[j]);
+        if (found != occurrences.end()) {
+          found->second.countB++;
+          found->second.positionB = j;
+          shared = true;
+        }
+      }
+
+      // nothing in common, every line is replaced
+      if (!shared) {
+        std::fill(removed_.begin() + range.aLow, removed_.begin() + range.aHigh, true);
+        std::fill(added_.begin() + range.bLow, added_.begin() + range.bHigh, true);
+        return;
+      }
+
+      std::vector<std::pair<int, int>> unique = {};
+      for (int i = range.aLow; i < range.aHigh; i++) {
+        const auto& occurrence = occurrences[a_[i]];
+        if (occurrence.countA == 1 && occurrence.countB == 1) {
+          unique.push_back({i, occurrence.positionB});
+        }
+      }
+
+      const auto anchors = longestIncreasing(unique);
+      if (anchors.empty()) {
+        myers(range);
+        return;
+      }
+
+      int aLow = range.aLow;
+      int bLow = range.bLow;
+      for (const auto& anchor : anchors) {
+        patience({aLow, anchor.first, bLow, anchor.second});
+        aLow = anchor.first + 1;
+        bLow = anchor.second + 1;
+      }
+      patience({aLow, range.aHigh, bLow, range.bHigh});
+    }
+
+    // Patience sorting over the positions in b, the pairs are already ordered by their position in a.
+    static std::vector<std::pair<int, int>> longestIncreasing(const std::vector<std::pair<int, int>>& pairs) {
+      std::vector<int> tops = {};
+      std::vector<int> previous(pairs.size(), -1);
+      for (size_t i = 0; i < pairs.size(); i++) {
+        const auto pile = std::lower_bound(tops.begin(), tops.end(), pairs[i].second, [&pairs](int index, int value) {
+          return pairs[index].second < value;
+        });
+        if (pile != tops.begin()) {
+          previous[i] = *(pile - 1);
+        }
+        if (pile == tops.end()) {
+          tops.push_back(static_cast<int>(i));
+        } else {
+          *pile = static_cast<int>(i);
+        }
+      }
+
+      std::vector<std::pair<int, int>> sequence(tops.size());
+      int index = tops.empty() ? -1 : tops.back();
+      for (size_t i = tops.size(); i > 0; i--) {
+        sequence[i - 1] = pairs[index];
+        index = previous[index];
+      }
+      return sequence;
+    }
+
+    void myers(Range range) {
+      if (!trim(range)) {
+        return;
+      }
+
+      const auto snake = middleSnake(range);
+      myers({range.aLow, range.aLow + snake.x, range.bLow, range.bLow + snake.y});
+      myers({range.aLow + snake.u, range.aHigh, range.bLow + snake.v, range.bHigh});
+    }
+
+    // Runs the search from both corners at once and returns where the paths meet, only two
+    // diagonal vectors are kept so memory stays linear in the size of the range. Like diff(1), the
+    // search gives up on the shortest script once it gets too expensive and splits at the forward
+    // path that got furthest, trading a slightly longer diff for a bounded running time.
+    Snake middleSnake(const Range& range) {
+      const int n = range.aHigh - range.aLow;
+      const int m = range.bHigh - range.bLow;
+      const int delta = n - m;
+      const bool odd = (delta & 1) != 0;
+      const int maxD = (n + m + 1) / 2;
+      int tooExpensive = 1;
+      for (int diagonals = n + m + 3; diagonals != 0; diagonals >>= 2) {
+        tooExpensive <<= 1;
+      }
+      tooExpensive = std::max(MinimumCost, tooExpensive);
+      const int offset = maxD + 1;
+      forward_.assign(2 * maxD + 3, 0);
+      backward_.assign(2 * maxD + 3, 0);
+
+      const int* a = a_.data() + range.aLow;
+      const int* b = b_.data() + range.bLow;
+
+      for (int d = 0; d <= maxD; d++) {
+        for (int k = -d; k <= d; k += 2) {
+          int x = (k == -d || (k != d && forward_[offset + k - 1] < forward_[offset + k + 1]))
+            ? forward_[offset + k + 1]
+            : forward_[offset + k - 1] + 1;
+          int y = x - k;
+          const int startX = x;
+          const int startY = y;
+          while (x < n && y < m && a[x] == b[y]) {
+            x++;
+            y++;
+          }
+          forward_[offset + k] = x;
+
+          const int reverseK = delta - k;
+          if (odd && reverseK >= -(d - 1) && reverseK <= d - 1 && x + backward_[offset + reverseK] >= n) {
+            return {startX, startY, x, y};
+          }
+        }
+
+        for (int k = -d; k <= d; k += 2) {
+          int x = (k == -d || (k != d && backward_[offset + k - 1] < backward_[offset + k + 1]))
+            ? backward_[offset + k + 1]
+            : backward_[offset + k - 1] + 1;
+          int y = x - k;
+          const int startX = x;
+          const int startY = y;
+          while (x < n && y < m && a[n - x - 1] == b[m - y - 1]) {
+            x++;
+            y++;
+          }
+          backward_[offset + k] = x;
+
+          const int forwardK = delta - k;
+          if (!odd && forwardK >= -d && forwardK <= d && x + forward_[offset + forwardK] >= n) {
+            return {n - x, m - y, n - startX, m - startY};
+          }
+        }
+
+        if (d >= tooExpensive) {
+          int bestK = -d;
+          for (int k = -d; k <= d; k += 2) {
+            const int x = std::min(forward_[offset + k], n);
+            const int bestX = std::min(forward_[offset + bestK], n);
+            if (2 * x - k > 2 * bestX - bestK && x - k <= m) {
+              bestK = k;
+            }
+          }
+          const int x = std::min(forward_[offset + bestK], n);
+          const int y = std::min(x - bestK, m);
+          return {x, y, x, y};
+        }
+      }
+
+      return {0, 0, 0, 0};
+    }
+
+    std::vector<int> a_;
+    std::vector<int> b_;
+    std::vector<bool> removed_;
+    std::vector<bool> added_;
+    std::vector<int> forward_;
+    std::vector<int> backward_;
+  };
+
+  struct Line {
+    char kind;
+    int a;
+    int b;
+  };
+
+  std::string hunkRange(int start, int count) {
+    // an empty range points at the line before it, as diff -u does
+    const int first = count == 0 ? start : start + 1;
+    return std::to_string(first) + (count == 1 ? "" : "," + std::to_string(count));
+  }
+}
+
+std::string unifiedDiff(
+  std::string_view before,
+  std::string_view after,
+  const std::string& beforeName,
+  const std::string& afterName,
+  unsigned int context
+) {
+  const auto a = splitLines(before);
+  const auto b = splitLines(after);
+  LineDiff lineDiff(a, b);
+  lineDiff.run();
+
+  std::vector<Line> lines = {};
+  lines.reserve(a.size() + b.size());
+  int i = 0;
+  int j = 0;
+  while (i < static_cast<int>(a.size()) || j < static_cast<int>(b.size())) {
+    if (i < static_cast<int>(a.size()) && lineDiff.removed()[i]) {
+      lines.push_back({'-', i++, j});
+    } else if (j < static_cast<int>(b.size()) && lineDiff.added()[j]) {
+      lines.push_back({'+', i, j++});
+    } else {
+      lines.push_back({' ', i++, j++});
+    }
+  }
+
+  std::string result;
+  const int contextLines = static_cast<int>(context);
+  size_t next = 0;
+  while (next < lines.size()) {
+    while (next < lines.size() && lines[next].kind == ' ') {
+      next++;
+    }
+    if (next == lines.size()) {
+      break;
+    }
+
+    if (result.empty()) {
+      result = "--- " + beforeName + "\n+++ " + afterName + "\n";
+    }
+
+    // a hunk keeps growing while the next change is close enough for the contexts to touch
+    const size_t first = next >= static_cast<size_t>(contextLines) ? next - contextLines : 0;
+    size_t last = next;
+    size_t equalRun = 0;
+    for (size_t k = next; k < lines.size(); k++) {
+      if (lines[k].kind != ' ') {
+        last = k;
+        equalRun = 0;
+      } else if (++equalRun > static_cast<size_t>(2 * contextLines)) {
+        break;
+      }
+    }
+    const size_t end = std::min(lines.size(), last + 1 + contextLines);
+
+    int countA = 0;
+    int countB = 0;
+    for (size_t k = first; k < end; k++) {
+      countA += lines[k].kind != '+';
+      countB += lines[k].kind != '-';
+    }
+
+    result += "@@ -" + hunkRange(lines[first].a, countA) + " +" + hunkRange(lines[first].b, countB) + " @@\n";
+    for (size_t k = first; k < end; k++) {
+      const auto& text = lines[k].kind == '+' ? b[lines[k].b] : a[lines[k].a];
+      result += lines[k].kind;
+      result.append(text.data(), text.size());
+      result += '\n';
+    }
+
+    next = end;
+  }
+
+  return result;
+}
+
+}
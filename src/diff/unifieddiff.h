@@ -0,0 +1,21 @@
+#ifndef DIFF_UNIFIEDDIFF_H
+#define DIFF_UNIFIEDDIFF_H
+#include <string>
+#include <string_view>
+
+namespace diff {
+
+// Line based diff in unified format, returns an empty string when both texts have the same lines.
+// Lines unique to both sides anchor the diff (patience) and the gaps between them are diffed with
+// linear space Myers, so long lists with a few changes cost close to a single pass.
+std::string unifiedDiff(
+  std::string_view before,
+  std::string_view after,
+  const std::string& beforeName,
+  const std::string& afterName,
+  unsigned int context = 3
+);
+
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef FILE_UTILS_BATCHIO_H
+#define FILE_UTILS_BATCHIO_H
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace file_utils {
+
+struct FileStatus {
+  bool exists;
+  bool isDirectory;
+  unsigned long long device;
+  unsigned long long inode;
+  unsigned long long size;
+  // nanoseconds since the epoch, 0 where the platform doesn't tell
+  unsigned long long modified;
+};
+
+struct FileContents {
+  bool ok;
+  std::string data;
+};
+
+// Metadata lookups and whole file reads issued as one batch, so backends that can keep many
+// requests in flight (io_uring) pay the latency once per batch instead of once per file.
+class BatchIo {
+public:
+  enum Backend { Auto, Sync, Uring };
+
+  static std::unique_ptr<BatchIo> create(Backend backend);
+
+  virtual ~BatchIo();
+  virtual const char* name() const = 0;
+  virtual std::vector<FileStatus> stat(const std::vector<std::string>& paths) = 0;
+  virtual std::vector<FileContents> readFiles(const std::vector<std::string>& paths) = 0;
+  // Reads no more than the first maxBytes of every file, for searches that only need the start of a file.
+  virtual std::vector<FileContents> readPrefixes(const std::vector<std::string>& paths, unsigned long long maxBytes) = 0;
+};
+
+class SyncBatchIo : public BatchIo {
+public:
+  const char* name() const override;
+  std::vector<FileStatus> stat(const std::vector<std::string>& paths) override;
+  std::vector<FileContents> readFiles(const std::vector<std::string>& paths) override;
+  std::vector<FileContents> readPrefixes(const std::vector<std::string>& paths, unsigned long long maxBytes) override;
+
+  static FileStatus statFile(const std::string& path);
+  static FileContents readFile(const std::string& path);
+  static FileContents readPrefix(const std::string& path, unsigned long long maxBytes);
+};
+
+}
+
+#endif
@@ -1,40 +1,182 @@
 #ifndef FILE_UTILS_DIRECTORY_H
 #define FILE_UTILS_DIRECTORY_H
-#include <functional>
+#include <iterator>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 namespace file_utils {
 
 class Directory {
 public:
-  Directory(const std::string& path, std::shared_ptr<Directory> parent);
+  // Returned from a visitor to prune the subtree below the visited directory or end the traversal,
+  // visitors returning void always continue.
+  enum VisitAction { Continue, SkipChildren, Stop };
 
-  const std::string& path() const;
+  // Pre-order iterator that steps through the tree using the parent links, so it needs no stack.
+  class DepthFirstIterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = const Directory;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Directory*;
+    using reference = const Directory&;
+
+    DepthFirstIterator(const Directory* current, const Directory* root);
+
+    reference operator*() const;
+    pointer operator->() const;
+    DepthFirstIterator& operator++();
+    bool operator==(const DepthFirstIterator& other) const;
+    bool operator!=(const DepthFirstIterator& other) const;
+
+    // The next increment moves past the subtree of the current directory instead of into it.
+    void skipChildren();
+  private:
+    const Directory* current_;
+    const Directory* root_;
+    bool descend_;
+  };
+
+  struct DepthFirstRange {
+    DepthFirstIterator begin() const;
+    DepthFirstIterator end() const;
+
+    const Directory* root;
+  };
+
+  Directory(std::string_view path, Directory* parent);
+
+  std::string_view path() const;
 
   bool hasCmakeFile() const;
-  const std::vector<Directory*> children() const;
-  const std::vector<std::string>& includeFiles() const;
-  const std::vector<std::string>& sourceFiles() const;
+  const std::vector<std::shared_ptr<Directory>>& children() const;
+  const std::vector<std::string_view>& includeFiles() const;
+  const std::vector<std::string_view>& sourceFiles() const;
 
   void addChild(const std::shared_ptr<Directory>& child);
   void addCmakeFile();
-  void addIncludeFile(const std::string& file);
-  void addSourceFile(const std::string& file);
-  void forEach(std::function<void(const Directory& directory)> callback) const;
-  void forEachIf(std::function<void(const Directory& directory)> callback, std::function<bool(const Directory& directory)> predicate) const;
-  void forEach(std::function<void(Directory& directory)> callback);
-  std::vector<Directory*> filter(std::function<bool(const Directory& directory)> predicate);
+  void addIncludeFile(std::string_view file);
+  void addSourceFile(std::string_view file);
+
+  DepthFirstRange depthFirst() const;
+
+  // Pre-order traversal without any allocation, returns false when a visitor stopped it early.
+  template<class Visitor>
+  bool visitDepthFirst(Visitor&& visitor) const;
+  template<class Visitor>
+  bool visitDepthFirst(Visitor&& visitor);
+
+  // Level order traversal, the queue lives in the caller's scratch buffer so it can be reused between calls.
+  template<class Visitor>
+  bool visitBreadthFirst(Visitor&& visitor, std::vector<const Directory*>& scratch) const;
+  template<class Visitor>
+  bool visitBreadthFirst(Visitor&& visitor, std::vector<const Directory*>& scratch);
 private:
-  std::string path_;
-  std::vector<std::string> includeFiles_;
-  std::vector<std::string> sourceFiles_;
+  template<class Node>
+  static Node* nextDepthFirst(Node* node, const Directory* root, bool descend);
+  template<class Node, class Visitor>
+  static VisitAction visit(Visitor& visitor, Node& node);
+  template<class Node, class Visitor>
+  static bool visitDepthFirst(Node* root, Visitor& visitor);
+  template<class Node, class Visitor>
+  static bool visitBreadthFirst(Node* root, Visitor& visitor, std::vector<const Directory*>& scratch);
+
+  std::string_view path_;
+  std::vector<std::string_view> includeFiles_;
+  std::vector<std::string_view> sourceFiles_;
   bool hasCmakeFile_;
-  std::shared_ptr<Directory> parent_;
+  Directory* parent_;
+  size_t indexInParent_;
   std::vector<std::shared_ptr<Directory>> children_;
 };
 
+template<class Node>
+Node* Directory::nextDepthFirst(Node* node, const Directory* root, bool descend) {
+  if (descend && !node->children_.empty()) {
+    return node->children_.front().get();
+  }
+
+  while (node != root) {
+    Node* parent = node->parent_;
+    const auto next = node->indexInParent_ + 1;
+    if (next < parent->children_.size()) {
+      return parent->children_[next].get();
+    }
+    node = parent;
+  }
+
+  return nullptr;
+}
+
+template<class Node, class Visitor>
+Directory::VisitAction Directory::visit(Visitor& visitor, Node& node) {
+  if constexpr (std::is_void_v<std::invoke_result_t<Visitor&, Node&>>) {
+    visitor(node);
+    return Continue;
+  } else {
+    return visitor(node);
+  }
+}
+
+template<class Node, class Visitor>
+bool Directory::visitDepthFirst(Node* root, Visitor& visitor) {
+  for (Node* node = root; node;) {
+    const auto action = visit(visitor, *node);
+    if (action == Stop) {
+      return false;
+    }
+    node = nextDepthFirst(node, root, action == Continue);
+  }
+
+  return true;
+}
+
+template<class Node, class Visitor>
+bool Directory::visitBreadthFirst(Node* root, Visitor& visitor, std::vector<const Directory*>& scratch) {
+  scratch.clear();
+  scratch.push_back(root);
+
+  for (size_t next = 0; next < scratch.size(); next++) {
+    // every queued directory is reachable from root, so it is only as const as root is
+    Node* node = const_cast<Node*>(scratch[next]);
+    const auto action = visit(visitor, *node);
+    if (action == Stop) {
+      return false;
+    }
+
+    if (action == Continue) {
+      for (const auto& child : node->children_) {
+        scratch.push_back(child.get());
+      }
+    }
+  }
+
+  return true;
+}
+
+template<class Visitor>
+bool Directory::visitDepthFirst(Visitor&& visitor) const {
+  return visitDepthFirst(this, visitor);
+}
+
+template<class Visitor>
+bool Directory::visitDepthFirst(Visitor&& visitor) {
+  return visitDepthFirst(this, visitor);
+}
+
+template<class Visitor>
+bool Directory::visitBreadthFirst(Visitor&& visitor, std::vector<const Directory*>& scratch) const {
+  return visitBreadthFirst(this, visitor, scratch);
+}
+
+template<class Visitor>
+bool Directory::visitBreadthFirst(Visitor&& visitor, std::vector<const Directory*>& scratch) {
+  return visitBreadthFirst(this, visitor, scratch);
+}
+
 }
 
 #endif
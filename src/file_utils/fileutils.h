@@ -1,7 +1,11 @@
 #ifndef FILEUTILS_H
 #define FILEUTILS_H
+#include "batchio.h"
+
+#include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace cmake {
@@ -20,21 +24,55 @@ public:
 
   std::vector<cmake::CmakeFunctionArgument> availableFileTypeArguments(const std::string& projectName) const;
 
-  std::shared_ptr<cmake::CmakeFunction> createIncludeFilesFunction(const file_utils::Directory* directory);
+  std::shared_ptr<cmake::CmakeFunction> createIncludeFilesFunction(const file_utils::Directory* directory) const;
 
-  std::shared_ptr<cmake::CmakeFunction> createSourceFilesFunction(const file_utils::Directory* directory);
+  std::shared_ptr<cmake::CmakeFunction> createSourceFilesFunction(const file_utils::Directory* directory) const;
 
-  std::vector<std::string> includeFiles;
-  std::vector<std::string> sourceFiles;
+  std::vector<std::string_view> includeFiles;
+  std::vector<std::string_view> sourceFiles;
 };
 
 class IgnoreFile;
+class PathArena;
+
+struct WalkOptions {
+  enum Source { FileSystem, GitIndex };
+  enum SymlinkPolicy { SkipSymlinks, FollowSymlinksOnce, FollowSymlinks };
+
+  Source source = FileSystem;
+  bool includeUntracked = false;
+  SymlinkPolicy symlinks = FollowSymlinksOnce;
+  BatchIo::Backend io = BatchIo::Auto;
+  // off for --dry-run, the walk then leaves the untracked cache in _build as it is
+  bool saveCaches = true;
+};
+
+// Directories left out of a walk because they had already been seen through another path.
+struct WalkReport {
+  std::vector<std::string> describe() const;
+
+  std::vector<std::string> duplicateDirectories;
+  std::vector<std::string> cyclicDirectories;
+};
 
-std::string makeRelative(const std::string& target);
-std::string makeRelative(const std::string& target, const std::string& rootPath);
+std::string makeRelative(std::string_view target, std::string_view rootPath);
 std::string directoryName(const std::string& path);
+// Shell style pattern for paths relative to the root without the leading ./, * and ? stay within a
+// directory name and ** matches any number of directories.
+bool matchesGlob(std::string_view pattern, std::string_view path);
 void createDir(const std::string& name);
-std::shared_ptr<Directory> getDirectories(const IgnoreFile& ignoreFile);
+// Writes the contents next to path and renames them over it, so readers see either the old or the new file.
+bool replaceFile(const std::string& path, const std::string& contents);
+// The first executable called name in a directory of $PATH, empty when there is none.
+std::string findProgram(const std::string& name);
+std::shared_ptr<Directory> getDirectories(const IgnoreFile& ignoreFile, PathArena& paths, const WalkOptions& options, WalkReport& report);
+void walkProjects(
+  const IgnoreFile& ignoreFile,
+  PathArena& paths,
+  const WalkOptions& options,
+  WalkReport& report,
+  const std::function<void(const Directory&)>& onProject
+);
 DirectoryFiles getFilesForProject(const Directory* directory);
 
 }
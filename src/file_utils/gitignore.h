@@ -0,0 +1,40 @@
+#ifndef FILE_UTILS_GITIGNORE_H
+#define FILE_UTILS_GITIGNORE_H
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace file_utils {
+
+// git's exclude rules for files the index doesn't know: .git/info/exclude and the .gitignore of
+// every directory reached. A rule of a deeper .gitignore wins over the ones above it and the last
+// matching rule of a file wins, ! patterns include a path again. Character classes aren't supported.
+class GitIgnore {
+public:
+  explicit GitIgnore(const std::string& gitDirectory);
+
+  // Reads the .gitignore of a directory as walked, "." or "./dir". Parents have to be added before their children.
+  void addDirectory(const std::string& directory);
+  bool excludes(std::string_view path, bool isDirectory) const;
+
+private:
+  struct Rule {
+    // the directory of the file the rule is from, "." for the root and .git/info/exclude
+    std::string base;
+    std::string pattern;
+    bool negated;
+    bool directoryOnly;
+    // matched against the path below base instead of the file name alone
+    bool anchored;
+  };
+
+  void addRules(const std::string& file, const std::string& base);
+
+  std::vector<Rule> rules_;
+  std::unordered_set<std::string> added_;
+};
+
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef FILE_UTILS_GITINDEX_H
+#define FILE_UTILS_GITINDEX_H
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace file_utils {
+
+class MappedFile;
+
+struct GitIndexEntry {
+  std::string_view path;
+  unsigned int mode;
+};
+
+// Reader for the on-disk .git/index (versions 2 to 4), entries are visited in index (sorted) order.
+// open() returns nullptr for a split index, which holds only the entries changed since the shared one.
+class GitIndex {
+public:
+  static const unsigned int GitlinkMode = 0160000;
+  static const unsigned int SymlinkMode = 0120000;
+
+  static std::unique_ptr<GitIndex> open(const std::string& gitDirectory);
+  static std::string findGitDirectory(const std::string& workTree);
+
+  ~GitIndex();
+
+  const std::string& path() const;
+  bool forEachEntry(const std::function<void(const GitIndexEntry& entry)>& callback) const;
+
+private:
+  GitIndex(const std::string& path, std::unique_ptr<MappedFile> file, unsigned int version, unsigned int entryCount, size_t hashSize);
+  // leaves cursor after the last entry, callback may be nullptr
+  bool parseEntries(const std::function<void(const GitIndexEntry& entry)>* callback, const unsigned char*& cursor) const;
+  bool hasExtension(const char* signature) const;
+
+  std::string path_;
+  std::unique_ptr<MappedFile> file_;
+  unsigned int version_;
+  unsigned int entryCount_;
+  size_t hashSize_;
+};
+
+}
+
+#endif
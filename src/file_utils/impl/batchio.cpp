@@ -0,0 +1,132 @@
+#include "../batchio.h"
+#include "../mappedfile.h"
+#include "uringbatchio.h"
+
+#include <algorithm>
+#include <filesystem>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#define FILE_UTILS_HAS_STAT 1
+#endif
+
+namespace filesystem = std::filesystem;
+
+namespace file_utils {
+
+#ifdef FILE_UTILS_HAS_STAT
+namespace {
+  unsigned long long modifiedNanoseconds(const struct stat& status) {
+#ifdef __APPLE__
+    const auto& modified = status.st_mtimespec;
+#else
+    const auto& modified = status.st_mtim;
+#endif
+    return static_cast<unsigned long long>(modified.tv_sec) * 1000000000ull + static_cast<unsigned long long>(modified.tv_nsec);
+  }
+}
+#endif
+
+std::unique_ptr<BatchIo> BatchIo::create(Backend backend) {
+#ifdef FILE_UTILS_HAS_URING
+  if (backend != Sync) {
+    auto uring = UringBatchIo::create();
+    if (uring) {
+      return uring;
+    }
+  }
+#else
+  (void)backend;
+#endif
+
+  return std::make_unique<SyncBatchIo>();
+}
+
+BatchIo::~BatchIo() = default;
+
+const char* SyncBatchIo::name() const {
+  return "sync";
+}
+
+std::vector<FileStatus> SyncBatchIo::stat(const std::vector<std::string>& paths) {
+  std::vector<FileStatus> statuses = {};
+  statuses.reserve(paths.size());
+  for (const auto& path : paths) {
+    statuses.push_back(statFile(path));
+  }
+  return statuses;
+}
+
+std::vector<FileContents> SyncBatchIo::readFiles(const std::vector<std::string>& paths) {
+  std::vector<FileContents> contents = {};
+  contents.reserve(paths.size());
+  for (const auto& path : paths) {
+    contents.push_back(readFile(path));
+  }
+  return contents;
+}
+
+std::vector<FileContents> SyncBatchIo::readPrefixes(const std::vector<std::string>& paths, unsigned long long maxBytes) {
+  std::vector<FileContents> contents = {};
+  contents.reserve(paths.size());
+  for (const auto& path : paths) {
+    contents.push_back(readPrefix(path, maxBytes));
+  }
+  return contents;
+}
+
+FileStatus SyncBatchIo::statFile(const std::string& path) {
+#ifdef FILE_UTILS_HAS_STAT
+  struct stat status;
+  if (::stat(path.c_str(), &status) != 0) {
+    return {false, false, 0, 0, 0, 0};
+  }
+
+  return {
+    true,
+    S_ISDIR(status.st_mode),
+    static_cast<unsigned long long>(status.st_dev),
+    static_cast<unsigned long long>(status.st_ino),
+    static_cast<unsigned long long>(status.st_size),
+    modifiedNanoseconds(status)
+  };
+#else
+  std::error_code error;
+  const auto status = filesystem::status(path, error);
+  if (error || !filesystem::exists(status)) {
+    return {false, false, 0, 0, 0, 0};
+  }
+
+  const bool isDirectory = filesystem::is_directory(status);
+  const auto canonicalPath = filesystem::canonical(path, error);
+  return {
+    true,
+    isDirectory,
+    0,
+    std::hash<std::string>()(canonicalPath.generic_string()),
+    isDirectory ? 0 : static_cast<unsigned long long>(filesystem::file_size(path, error)),
+    0
+  };
+#endif
+}
+
+FileContents SyncBatchIo::readFile(const std::string& path) {
+  const auto file = MappedFile::open(path);
+  if (!file) {
+    return {false, ""};
+  }
+
+  return {true, std::string(file->data(), file->size())};
+}
+
+FileContents SyncBatchIo::readPrefix(const std::string& path, unsigned long long maxBytes) {
+  const auto file = MappedFile::open(path);
+  if (!file) {
+    return {false, ""};
+  }
+
+  // only the pages of the prefix get faulted in
+  return {true, std::string(file->data(), static_cast<size_t>(std::min<unsigned long long>(file->size(), maxBytes)))};
+}
+
+}
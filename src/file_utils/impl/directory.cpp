@@ -1,15 +1,12 @@
 #include "../directory.h"
-#include <algorithm>
-#include <queue>
-#include <iterator>
 
 namespace file_utils {
 
-Directory::Directory(const std::string& path, std::shared_ptr<Directory> parent)
-  : path_(path), hasCmakeFile_(false), parent_(parent)  {
+Directory::Directory(std::string_view path, Directory* parent)
+  : path_(path), hasCmakeFile_(false), parent_(parent), indexInParent_(0)  {
 }
 
-const std::string& Directory::path() const {
+std::string_view Directory::path() const {
   return path_;
 }
 
@@ -17,24 +14,21 @@ bool Directory::hasCmakeFile() const {
   return hasCmakeFile_;
 }
 
-const std::vector<Directory*> Directory::children() const {
-  std::vector<Directory*> result = {};
-  std::transform(children_.begin(), children_.end(), std::back_inserter(result), [](const auto& child){
-    return child.get();
-  });
-
-  return result;
+const std::vector<std::shared_ptr<Directory>>& Directory::children() const {
+  return children_;
 }
 
-const std::vector<std::string>& Directory::includeFiles() const {
+const std::vector<std::string_view>& Directory::includeFiles() const {
   return includeFiles_;
 }
 
-const std::vector<std::string>& Directory::sourceFiles() const {
+const std::vector<std::string_view>& Directory::sourceFiles() const {
   return sourceFiles_;
 }
 
 void Directory::addChild(const std::shared_ptr<Directory>& child) {
+  child->parent_ = this;
+  child->indexInParent_ = children_.size();
   children_.push_back(child);
 }
 
@@ -42,88 +36,54 @@ void Directory::addCmakeFile() {
   hasCmakeFile_ = true;
 }
 
-void Directory::addIncludeFile(const std::string& file) {
+void Directory::addIncludeFile(std::string_view file) {
   includeFiles_.push_back(file);
 }
 
-void Directory::addSourceFile(const std::string& file) {
+void Directory::addSourceFile(std::string_view file) {
   sourceFiles_.push_back(file);
 }
 
-void Directory::forEach(std::function<void(const Directory& directory)> callback) const {
-  std::queue<const Directory*> childrenToCheck = {};
-  childrenToCheck.push(this);
-
-  while(!childrenToCheck.empty()) {
-    auto& directory = childrenToCheck.front();
-    childrenToCheck.pop();
-
-    callback(*directory);
-
-    for(auto& child : directory->children_) {
-      childrenToCheck.push(child.get());
-    }
-  }
+Directory::DepthFirstRange Directory::depthFirst() const {
+  return {this};
 }
 
-void Directory::forEachIf(std::function<void(
-  const Directory& directory)> callback,
-  std::function<bool(const Directory& directory)> predicate
-) const {
-  std::queue<const Directory*> childrenToCheck = {};
-  childrenToCheck.push(this);
-
-  while(!childrenToCheck.empty()) {
-    auto& directory = childrenToCheck.front();
-    childrenToCheck.pop();
-
-    if (!predicate(*directory)) {
-      continue;
-    }
-
-    callback(*directory);
-
-    for(auto& child : directory->children_) {
-      childrenToCheck.push(child.get());
-    }
-
-  }
+Directory::DepthFirstIterator Directory::DepthFirstRange::begin() const {
+  return {root, root};
 }
 
-void Directory::forEach(std::function<void(Directory& directory)> callback) {
-  std::queue<Directory*> childrenToCheck = {};
-  childrenToCheck.push(this);
+Directory::DepthFirstIterator Directory::DepthFirstRange::end() const {
+  return {nullptr, root};
+}
 
-  while(!childrenToCheck.empty()) {
-    auto& directory = childrenToCheck.front();
-    childrenToCheck.pop();
+Directory::DepthFirstIterator::DepthFirstIterator(const Directory* current, const Directory* root)
+  : current_(current), root_(root), descend_(true) {
+}
 
-    callback(*directory);
+Directory::DepthFirstIterator::reference Directory::DepthFirstIterator::operator*() const {
+  return *current_;
+}
 
-    for(auto& child : directory->children_) {
-      childrenToCheck.push(child.get());
-    }
-  }
+Directory::DepthFirstIterator::pointer Directory::DepthFirstIterator::operator->() const {
+  return current_;
 }
 
-std::vector<Directory*> Directory::filter(std::function<bool(const Directory& directory)> predicate) {
-  std::vector<Directory*> result = {};
-  std::queue<Directory*> childrenToCheck = {};
-  childrenToCheck.push(this);
+Directory::DepthFirstIterator& Directory::DepthFirstIterator::operator++() {
+  current_ = nextDepthFirst(current_, root_, descend_);
+  descend_ = true;
+  return *this;
+}
 
-  while (!childrenToCheck.empty()) {
-    auto& directory = childrenToCheck.front();
-    childrenToCheck.pop();
-    if(predicate(*directory)) {
-      result.push_back(directory);
-    }
+bool Directory::DepthFirstIterator::operator==(const DepthFirstIterator& other) const {
+  return current_ == other.current_;
+}
 
-    for(auto& child : directory->children_) {
-      childrenToCheck.push(child.get());
-    }
-  }
+bool Directory::DepthFirstIterator::operator!=(const DepthFirstIterator& other) const {
+  return current_ != other.current_;
+}
 
-  return result;
+void Directory::DepthFirstIterator::skipChildren() {
+  descend_ = false;
 }
 
 }
@@ -1,13 +1,23 @@
 #include "../fileutils.h"
+#include "../batchio.h"
 #include "../ignorefile.h"
 #include "../directory.h"
+#include "../gitignore.h"
+#include "../gitindex.h"
+#include "../patharena.h"
 
 #include "../../cmake/cmakefile.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <filesystem>
+#include <fstream>
 #include <functional>
 #include <queue>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace filesystem = std::filesystem;
 
@@ -16,40 +26,556 @@ namespace {
 const std::vector<std::string> HEADER_EXTENSIONS = {".h", ".hpp", ".hh"};
 const std::vector<std::string> SOURCE_EXTENSIONS = {".c", ".cpp", ".c++"};
 
-bool hasExtension(const std::string& path, const std::vector<std::string>& extensions) {
+bool hasExtension(std::string_view path, const std::vector<std::string>& extensions) {
   return std::any_of(extensions.begin(), extensions.end(), [&path](const std::string& extension){
     const auto position = path.find(extension);
     return position == path.size() - extension.size();
   });
 }
 
-std::shared_ptr<Directory> walkDirectory(const filesystem::path& rootPath, const IgnoreFile& ignoreFile, std::shared_ptr<Directory> parent) {
+// The files addFile keeps track of.
+bool isProjectFile(const std::string& path) {
+  return hasExtension(path, HEADER_EXTENSIONS) || hasExtension(path, SOURCE_EXTENSIONS) || path.find("CMakeLists.txt") != std::string::npos;
+}
+
+void addFile(Directory& directory, const std::string& path, PathArena& paths) {
+  if (hasExtension(path, HEADER_EXTENSIONS)) {
+    directory.addIncludeFile(paths.add(path));
+  } else if (hasExtension(path, SOURCE_EXTENSIONS)) {
+    directory.addSourceFile(paths.add(path));
+  } else if (path.find("CMakeLists.txt") != std::string::npos) {
+    directory.addCmakeFile();
+  }
+}
+
+bool isInside(std::string_view path, std::string_view directory) {
+  return path.size() > directory.size() && path[directory.size()] == '/' && path.compare(0, directory.size(), directory) == 0;
+}
+
+std::string_view fileName(std::string_view path) {
+  return path.substr(path.rfind('/') + 1);
+}
+
+struct DirectoryId {
+  unsigned long long device;
+  unsigned long long inode;
+
+  bool operator==(const DirectoryId& other) const {
+    return device == other.device && inode == other.inode;
+  }
+};
+
+struct DirectoryIdHash {
+  size_t operator()(const DirectoryId& id) const {
+    return std::hash<unsigned long long>()((id.inode * 0x9e3779b97f4a7c15ULL) ^ id.device);
+  }
+};
 
-  std::shared_ptr<Directory> currentDirectory = std::make_shared<Directory>(rootPath.generic_string(), parent);
+struct SubDirectory {
+  std::string path;
+  bool isSymlink;
+};
+
+struct DeferredSymlink {
+  std::string path;
+  FileStatus status;
+  Directory* parent;
+};
+
+struct WalkState {
+  const IgnoreFile& ignoreFile;
+  PathArena& paths;
+  const WalkOptions& options;
+  WalkReport& report;
+  BatchIo& io;
+  std::unordered_set<DirectoryId, DirectoryIdHash> visited;
+  std::vector<DirectoryId> ancestors;
+  std::vector<DeferredSymlink> deferredSymlinks;
+  // set while looking for untracked files, which git's exclude rules apply to
+  GitIgnore* gitIgnore = nullptr;
+};
+
+// Registers the directory as being walked, returns false when it should be pruned instead.
+bool enterDirectory(WalkState& state, const std::string& path, bool isSymlink, const FileStatus& status) {
+  if (isSymlink && state.options.symlinks == WalkOptions::SkipSymlinks) {
+    return false;
+  }
+
+  if (!status.exists) {
+    return false;
+  }
+
+  const DirectoryId id = {status.device, status.inode};
+  if (std::find(state.ancestors.begin(), state.ancestors.end(), id) != state.ancestors.end()) {
+    state.report.cyclicDirectories.push_back(path);
+    return false;
+  }
+
+  if (state.options.symlinks != WalkOptions::FollowSymlinks && !state.visited.insert(id).second) {
+    state.report.duplicateDirectories.push_back(path);
+    return false;
+  }
+
+  state.ancestors.push_back(id);
+  return true;
+}
 
-  for (const auto& entry : filesystem::directory_iterator(rootPath)) {
-    const auto& path = entry.path().generic_string();
-    if (ignoreFile.contains(path)) {
+bool enterDirectory(WalkState& state, const std::string& path, bool isSymlink) {
+  return enterDirectory(state, path, isSymlink, state.io.stat({path}).front());
+}
+
+// All subdirectories of a listing are stat'ed in one batch instead of once each.
+std::vector<FileStatus> statSubDirectories(WalkState& state, const std::vector<SubDirectory>& subDirectories) {
+  std::vector<std::string> paths = {};
+  paths.reserve(subDirectories.size());
+  for (const auto& subDirectory : subDirectories) {
+    paths.push_back(subDirectory.path);
+  }
+  return state.io.stat(paths);
+}
+
+void leaveDirectory(WalkState& state) {
+  state.ancestors.pop_back();
+}
+
+struct EntryType {
+  bool isDirectory;
+  bool isSymlink;
+};
+
+// Uses the type reported by the directory listing, only symlinks need an extra stat.
+EntryType entryType(const filesystem::directory_entry& entry) {
+  std::error_code error;
+  const bool isSymlink = entry.is_symlink(error);
+  const bool isDirectory = entry.is_directory(error);
+  return {isDirectory && !error, isSymlink};
+}
+
+std::shared_ptr<Directory> walkDirectory(WalkState& state, const std::string& rootPath, Directory* parent);
+
+std::shared_ptr<Directory> walkSubDirectory(WalkState& state, const std::string& path, bool isSymlink, const FileStatus& status, Directory* parent) {
+  if (!enterDirectory(state, path, isSymlink, status)) {
+    return nullptr;
+  }
+
+  auto directory = walkDirectory(state, path, parent);
+  leaveDirectory(state);
+  return directory;
+}
+
+std::shared_ptr<Directory> walkDirectory(WalkState& state, const std::string& rootPath, Directory* parent) {
+  std::shared_ptr<Directory> currentDirectory = std::make_shared<Directory>(state.paths.add(rootPath), parent);
+  if (state.gitIgnore != nullptr) {
+    state.gitIgnore->addDirectory(rootPath);
+  }
+
+  std::vector<SubDirectory> subDirectories = {};
+  std::error_code error;
+  for (const auto& entry : filesystem::directory_iterator(rootPath, error)) {
+    auto path = entry.path().generic_string();
+    if (state.ignoreFile.contains(path)) {
+      continue;
+    }
+
+    const auto type = entryType(entry);
+    if (state.gitIgnore != nullptr && state.gitIgnore->excludes(path, type.isDirectory)) {
+      continue;
+    }
+    if (type.isDirectory) {
+      if (!type.isSymlink || state.options.symlinks != WalkOptions::SkipSymlinks) {
+        subDirectories.push_back({std::move(path), type.isSymlink});
+      }
       continue;
     }
 
-    if (entry.status().type() == filesystem::file_type::directory) {
-      currentDirectory->addChild(walkDirectory(entry.path(), ignoreFile, currentDirectory));
+    addFile(*currentDirectory, path, state.paths);
+  }
+
+  const auto statuses = statSubDirectories(state, subDirectories);
+  for (size_t i = 0; i < subDirectories.size(); i++) {
+    const auto& subDirectory = subDirectories[i];
+    if (subDirectory.isSymlink && state.options.symlinks == WalkOptions::FollowSymlinksOnce) {
+      state.deferredSymlinks.push_back({subDirectory.path, statuses[i], currentDirectory.get()});
       continue;
     }
 
-    if (hasExtension(path, HEADER_EXTENSIONS)) {
-      currentDirectory->addIncludeFile(path);
-    } else if (hasExtension(path, SOURCE_EXTENSIONS)) {
-      currentDirectory->addSourceFile(path);
-    } else if (path.find("CMakeLists.txt") != std::string::npos) {
+    auto child = walkSubDirectory(state, subDirectory.path, subDirectory.isSymlink, statuses[i], currentDirectory.get());
+    if (child) {
+      currentDirectory->addChild(child);
+    }
+  }
+
+  return currentDirectory;
+}
+
+// Symlinked directories are walked after the real tree so the real path is the one that is kept.
+void walkDeferredSymlinks(WalkState& state) {
+  for (size_t i = 0; i < state.deferredSymlinks.size(); i++) {
+    const auto symlink = state.deferredSymlinks[i];
+    auto child = walkSubDirectory(state, symlink.path, true, symlink.status, symlink.parent);
+    if (child) {
+      symlink.parent->addChild(child);
+    }
+  }
+  state.deferredSymlinks.clear();
+}
+
+// Depth first walk that hands every project to onProject as soon as its subtree is complete and
+// then releases it, so only the directories on the current path and their projects are held in memory.
+std::shared_ptr<Directory> streamDirectory(
+  WalkState& state,
+  const std::string& rootPath,
+  Directory* parent,
+  bool insideProject,
+  const std::function<void(const Directory&)>& onProject
+) {
+  const auto mark = state.paths.mark();
+  auto currentDirectory = std::make_shared<Directory>(state.paths.add(rootPath), parent);
+
+  std::vector<SubDirectory> subDirectories = {};
+  std::vector<std::string> files = {};
+  std::error_code error;
+  for (const auto& entry : filesystem::directory_iterator(rootPath, error)) {
+    auto path = entry.path().generic_string();
+    if (state.ignoreFile.contains(path)) {
+      continue;
+    }
+
+    const auto type = entryType(entry);
+    if (type.isDirectory) {
+      if (!type.isSymlink || state.options.symlinks != WalkOptions::SkipSymlinks) {
+        subDirectories.push_back({std::move(path), type.isSymlink});
+      }
+    } else if (fileName(path) == "CMakeLists.txt") {
       currentDirectory->addCmakeFile();
+    } else {
+      files.push_back(std::move(path));
+    }
+  }
+
+  std::stable_partition(subDirectories.begin(), subDirectories.end(), [](const auto& subDirectory) {
+    return !subDirectory.isSymlink;
+  });
+
+  const bool keepFiles = insideProject || currentDirectory->hasCmakeFile();
+  if (keepFiles) {
+    for (const auto& file : files) {
+      addFile(*currentDirectory, file, state.paths);
+    }
+  }
+  files.clear();
+  files.shrink_to_fit();
+
+  const auto statuses = statSubDirectories(state, subDirectories);
+  for (size_t i = 0; i < subDirectories.size(); i++) {
+    if (!enterDirectory(state, subDirectories[i].path, subDirectories[i].isSymlink, statuses[i])) {
+      continue;
+    }
+
+    auto child = streamDirectory(state, subDirectories[i].path, currentDirectory.get(), keepFiles, onProject);
+    leaveDirectory(state);
+    if (child) {
+      currentDirectory->addChild(child);
     }
   }
 
+  if (currentDirectory->hasCmakeFile()) {
+    onProject(*currentDirectory);
+  }
+
+  if (currentDirectory->hasCmakeFile() || !insideProject) {
+    currentDirectory.reset();
+    state.paths.rewind(mark);
+  }
+
   return currentDirectory;
 }
 
+std::shared_ptr<Directory> readSubmodule(WalkState& state, const std::string& path, Directory* parent);
+
+std::shared_ptr<Directory> readGitIndex(WalkState& state, const GitIndex& index, const std::string& rootPath, Directory* parent) {
+  auto root = std::make_shared<Directory>(state.paths.add(rootPath), parent);
+  std::vector<Directory*> openDirectories = {root.get()};
+  std::vector<std::pair<std::string, Directory*>> symlinks = {};
+  std::vector<std::pair<std::string, Directory*>> files = {};
+  std::string ignoredPrefix;
+  std::string path;
+
+  const bool complete = index.forEachEntry([&](const GitIndexEntry& entry) {
+    path.assign(rootPath).append("/").append(entry.path);
+    if (!ignoredPrefix.empty() && path.compare(0, ignoredPrefix.size(), ignoredPrefix) == 0) {
+      return;
+    }
+    ignoredPrefix.clear();
+
+    // index entries are sorted, so a directory is complete once an entry falls outside of it
+    while (openDirectories.size() > 1 && !isInside(path, openDirectories.back()->path())) {
+      openDirectories.pop_back();
+    }
+
+    size_t separator = openDirectories.back()->path().size();
+    while ((separator = path.find('/', separator + 1)) != std::string::npos) {
+      const auto directoryPath = path.substr(0, separator);
+      if (state.ignoreFile.contains(directoryPath)) {
+        ignoredPrefix = directoryPath + "/";
+        return;
+      }
+
+      auto directory = std::make_shared<Directory>(state.paths.add(directoryPath), openDirectories.back());
+      openDirectories.back()->addChild(directory);
+      openDirectories.push_back(directory.get());
+    }
+
+    if (state.ignoreFile.contains(std::string(fileName(path)))) {
+      return;
+    }
+
+    const auto modeType = entry.mode & 0170000;
+    if (modeType == GitIndex::GitlinkMode) {
+      auto submodule = readSubmodule(state, path, openDirectories.back());
+      if (submodule) {
+        openDirectories.back()->addChild(submodule);
+      }
+      return;
+    }
+
+    if (modeType == GitIndex::SymlinkMode) {
+      symlinks.push_back({path, openDirectories.back()});
+      return;
+    }
+
+    if (isProjectFile(path)) {
+      files.push_back({path, openDirectories.back()});
+    }
+  });
+
+  if (!complete) {
+    return nullptr;
+  }
+
+  // deletions that aren't staged yet are still in the index, only files the work tree has are kept
+  std::vector<std::string> filePaths = {};
+  filePaths.reserve(files.size());
+  for (const auto& file : files) {
+    filePaths.push_back(file.first);
+  }
+  const auto fileStatuses = state.io.stat(filePaths);
+  for (size_t i = 0; i < files.size(); i++) {
+    if (fileStatuses[i].exists) {
+      addFile(*files[i].second, files[i].first, state.paths);
+    }
+  }
+
+  if (state.options.symlinks == WalkOptions::SkipSymlinks) {
+    for (const auto& symlink : symlinks) {
+      addFile(*symlink.second, symlink.first, state.paths);
+    }
+    return root;
+  }
+
+  // Directories read from the index are only registered once there are symlinks that could lead back into them
+  if (!symlinks.empty() && state.options.symlinks == WalkOptions::FollowSymlinksOnce) {
+    std::vector<std::string> directoryPaths = {};
+    root->visitDepthFirst([&directoryPaths](const Directory& directory) {
+      directoryPaths.push_back(std::string(directory.path()));
+    });
+
+    for (const auto& status : state.io.stat(directoryPaths)) {
+      if (status.exists) {
+        state.visited.insert({status.device, status.inode});
+      }
+    }
+  }
+
+  std::vector<std::string> symlinkPaths = {};
+  for (const auto& symlink : symlinks) {
+    symlinkPaths.push_back(symlink.first);
+  }
+  const auto statuses = state.io.stat(symlinkPaths);
+  for (size_t i = 0; i < symlinks.size(); i++) {
+    const auto& symlink = symlinks[i];
+    if (!statuses[i].isDirectory) {
+      addFile(*symlink.second, symlink.first, state.paths);
+      continue;
+    }
+
+    auto directory = walkSubDirectory(state, symlink.first, true, statuses[i], symlink.second);
+    if (directory) {
+      symlink.second->addChild(directory);
+    }
+  }
+  walkDeferredSymlinks(state);
+
+  return root;
+}
+
+std::shared_ptr<Directory> readSubmodule(WalkState& state, const std::string& path, Directory* parent) {
+  const auto gitDirectory = GitIndex::findGitDirectory(path);
+  const auto index = gitDirectory.empty() ? nullptr : GitIndex::open(gitDirectory);
+  if (index) {
+    auto submodule = readGitIndex(state, *index, path, parent);
+    if (submodule) {
+      return submodule;
+    }
+  }
+
+  const auto status = state.io.stat({path}).front();
+  if (!status.isDirectory) {
+    return nullptr;
+  }
+  return walkSubDirectory(state, path, false, status, parent);
+}
+
+// The entries of a directory as last listed, by its modification time when it was listed.
+struct DirectoryListing {
+  unsigned long long modified;
+  // the type, d for a directory, s for a symlink to one and f for anything else, followed by the name
+  std::vector<std::string> entries;
+};
+
+const std::string UntrackedCacheFile = "_build/.cmakegen-untracked";
+const std::string UntrackedCacheHeader = "cmakegen untracked 1";
+// a file added within a timestamp tick of the listing doesn't change the directory's modification
+// time, listings of directories modified this close to the walk aren't kept
+const unsigned long long RacyNanoseconds = 2000000000ull;
+
+std::unordered_map<std::string, DirectoryListing> loadDirectoryListings() {
+  std::unordered_map<std::string, DirectoryListing> listings = {};
+  std::ifstream stream(UntrackedCacheFile);
+  std::string line;
+  if (!std::getline(stream, line) || line != UntrackedCacheHeader) {
+    return listings;
+  }
+
+  // "<modified> <path>" followed by one tab indented line per entry
+  DirectoryListing* listing = nullptr;
+  while (std::getline(stream, line)) {
+    if (line.size() > 2 && line[0] == '\t' && listing != nullptr) {
+      listing->entries.push_back(line.substr(1));
+      continue;
+    }
+
+    std::istringstream fields(line);
+    DirectoryListing parsed = {0, {}};
+    std::string path;
+    if (fields >> parsed.modified && std::getline(fields >> std::ws, path) && !path.empty()) {
+      listing = &(listings[path] = parsed);
+    } else {
+      listing = nullptr;
+    }
+  }
+  return listings;
+}
+
+void saveDirectoryListings(const std::unordered_map<std::string, DirectoryListing>& listings) {
+  std::string contents = UntrackedCacheHeader + "\n";
+  for (const auto& [path, listing] : listings) {
+    contents += std::to_string(listing.modified) + " " + path + "\n";
+    for (const auto& entry : listing.entries) {
+      contents += "\t" + entry + "\n";
+    }
+  }
+  replaceFile(UntrackedCacheFile, contents);
+}
+
+// Like git's untracked cache, every directory of the index is listed once and listed again only
+// when its modification time changes, which adding, removing or renaming an entry does. Files
+// the index doesn't know are looked up in the listing, so changes to the index need no new listing.
+void addUntrackedFiles(WalkState& state, Directory& root) {
+  // walking untracked directories adds children, so the tree read from the index is listed up front
+  std::vector<Directory*> directories = {};
+  std::vector<std::string> directoryPaths = {};
+  root.visitDepthFirst([&directories, &directoryPaths](Directory& directory) {
+    directories.push_back(&directory);
+    directoryPaths.push_back(std::string(directory.path()));
+  });
+
+  const auto cached = loadDirectoryListings();
+  std::unordered_map<std::string, DirectoryListing> listings = {};
+  bool relisted = false;
+  const auto statuses = state.io.stat(directoryPaths);
+  const auto now = static_cast<unsigned long long>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count()
+  );
+  for (size_t i = 0; i < directories.size(); i++) {
+    auto* directory = directories[i];
+    const auto& directoryPath = directoryPaths[i];
+    const auto& status = statuses[i];
+    if (!status.exists) {
+      continue;
+    }
+
+    // the time is taken before listing, an entry added while listing makes the next walk list again
+    const auto found = cached.find(directoryPath);
+    DirectoryListing listing = {status.modified, {}};
+    if (status.modified != 0 && found != cached.end() && found->second.modified == status.modified) {
+      listing.entries = found->second.entries;
+    } else {
+      relisted = true;
+      std::error_code error;
+      for (const auto& entry : filesystem::directory_iterator(directoryPath, error)) {
+        const auto name = entry.path().filename().generic_string();
+        if (name == ".git") {
+          continue;
+        }
+        const auto type = entryType(entry);
+        listing.entries.push_back((type.isDirectory ? (type.isSymlink ? "s" : "d") : "f") + name);
+      }
+    }
+
+    std::unordered_set<std::string_view> knownNames = {};
+    for (const auto& file : directory->includeFiles()) {
+      knownNames.insert(fileName(file));
+    }
+    for (const auto& file : directory->sourceFiles()) {
+      knownNames.insert(fileName(file));
+    }
+    for (const auto& child : directory->children()) {
+      knownNames.insert(fileName(child->path()));
+    }
+
+    if (state.gitIgnore != nullptr) {
+      state.gitIgnore->addDirectory(directoryPath);
+    }
+    for (const auto& entry : listing.entries) {
+      const auto name = std::string_view(entry).substr(1);
+      const auto path = directoryPath + "/" + std::string(name);
+      if (knownNames.count(name) || state.ignoreFile.contains(path)
+        || (state.gitIgnore != nullptr && state.gitIgnore->excludes(path, entry[0] != 'f'))) {
+        continue;
+      }
+
+      if (entry[0] != 'f') {
+        auto child = walkSubDirectory(state, path, entry[0] == 's', state.io.stat({path}).front(), directory);
+        if (child) {
+          directory->addChild(child);
+        }
+        continue;
+      }
+
+      addFile(*directory, path, state.paths);
+    }
+
+    if (status.modified != 0 && status.modified + RacyNanoseconds < now) {
+      listings.emplace(directoryPath, std::move(listing));
+    }
+  }
+  if (state.options.saveCaches && (relisted || listings.size() != cached.size())) {
+    saveDirectoryListings(listings);
+  }
+}
+
+}
+
+std::vector<std::string> WalkReport::describe() const {
+  std::vector<std::string> lines = {};
+  for (const auto& path : duplicateDirectories) {
+    lines.push_back("Skipped " + path + ", the directory was already walked through another path");
+  }
+  for (const auto& path : cyclicDirectories) {
+    lines.push_back("Skipped " + path + ", the directory links back to one of its parents");
+  }
+  return lines;
 }
 
 bool DirectoryFiles::empty() const {
@@ -69,30 +595,26 @@ std::vector<cmake::CmakeFunctionArgument> DirectoryFiles::availableFileTypeArgum
   return arguments;
 }
 
-std::shared_ptr<cmake::CmakeFunction> DirectoryFiles::createIncludeFilesFunction(const file_utils::Directory* directory) {
+std::shared_ptr<cmake::CmakeFunction> DirectoryFiles::createIncludeFilesFunction(const file_utils::Directory* directory) const {
   std::vector<cmake::CmakeFunctionArgument> arguments = {{"INCLUDE_FILES"}};
-  std::transform(includeFiles.begin(), includeFiles.end(), std::back_inserter(arguments), [&directory](const std::string& file) {
+  std::transform(includeFiles.begin(), includeFiles.end(), std::back_inserter(arguments), [&directory](std::string_view file) {
     return cmake::CmakeFunctionArgument{file_utils::makeRelative(file, directory->path()), true};
   });
 
   return cmake::CmakeFunction::create("set", arguments);
 }
 
-std::shared_ptr<cmake::CmakeFunction> DirectoryFiles::createSourceFilesFunction(const file_utils::Directory* directory) {
+std::shared_ptr<cmake::CmakeFunction> DirectoryFiles::createSourceFilesFunction(const file_utils::Directory* directory) const {
   std::vector<cmake::CmakeFunctionArgument> arguments = {{"SRC_FILES"}};
-  std::transform(sourceFiles.begin(), sourceFiles.end(), std::back_inserter(arguments), [&directory](const std::string& file) {
+  std::transform(sourceFiles.begin(), sourceFiles.end(), std::back_inserter(arguments), [&directory](std::string_view file) {
     return cmake::CmakeFunctionArgument{file_utils::makeRelative(file, directory->path()), true};
   });
 
   return cmake::CmakeFunction::create("set", arguments);
 }
 
-std::string makeRelative(const std::string& target) {
-  return makeRelative(target, filesystem::current_path().generic_string());
-}
-
-std::string makeRelative(const std::string& target, const std::string& rootPath) {
-  return "." + target.substr(rootPath.size());
+std::string makeRelative(std::string_view target, std::string_view rootPath) {
+  return "./" + std::string(PathArena::relativeTo(target, rootPath));
 }
 
 std::string directoryName(const std::string& path) {
@@ -100,27 +622,143 @@ std::string directoryName(const std::string& path) {
   return filePath.filename().generic_string();
 }
 
+bool matchesGlob(std::string_view pattern, std::string_view path) {
+  // backtracking over the last star is enough for * and **, they only differ in crossing a /
+  size_t p = 0;
+  size_t s = 0;
+  size_t starPattern = std::string_view::npos;
+  size_t starPath = 0;
+  bool starCrossesDirectories = false;
+  while (s < path.size()) {
+    if (p < pattern.size() && pattern[p] == '*') {
+      starCrossesDirectories = p + 1 < pattern.size() && pattern[p + 1] == '*';
+      p += starCrossesDirectories ? 2 : 1;
+      if (starCrossesDirectories && p < pattern.size() && pattern[p] == '/') {
+        // a/**/b also matches a/b
+        if (matchesGlob(pattern.substr(p + 1), path.substr(s))) {
+          return true;
+        }
+      }
+      starPattern = p;
+      starPath = s;
+    } else if (p < pattern.size() && (pattern[p] == path[s] || (pattern[p] == '?' && path[s] != '/'))) {
+      p++;
+      s++;
+    } else if (starPattern != std::string_view::npos && (starCrossesDirectories || path[starPath] != '/')) {
+      p = starPattern;
+      s = ++starPath;
+    } else {
+      return false;
+    }
+  }
+
+  while (p < pattern.size() && pattern[p] == '*') {
+    p++;
+  }
+  return p == pattern.size();
+}
+
 void createDir(const std::string& name) {
   filesystem::create_directory(filesystem::current_path().append(name));
 }
 
-std::shared_ptr<Directory> getDirectories(const IgnoreFile& ignoreFile) {
-  return walkDirectory(filesystem::current_path(), ignoreFile, nullptr);
+bool replaceFile(const std::string& path, const std::string& contents) {
+  const auto parent = filesystem::path(path).parent_path();
+  std::error_code error;
+  if (!parent.empty()) {
+    filesystem::create_directories(parent, error);
+  }
+
+  const auto temporaryPath = path + ".tmp";
+  {
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    file << contents;
+    if (!file) {
+      return false;
+    }
+  }
+
+  filesystem::rename(temporaryPath, path, error);
+  if (error) {
+    filesystem::remove(temporaryPath, error);
+    return false;
+  }
+  return true;
+}
+
+std::string findProgram(const std::string& name) {
+#ifdef _WIN32
+  const char separator = ';';
+#else
+  const char separator = ':';
+#endif
+  const auto* path = std::getenv("PATH");
+  std::stringstream directories(path != nullptr ? path : "");
+  std::string directory;
+  while (std::getline(directories, directory, separator)) {
+    const auto candidate = filesystem::path(directory.empty() ? "." : directory) / name;
+    std::error_code error;
+    const auto status = filesystem::status(candidate, error);
+    const auto executable = filesystem::perms::owner_exec | filesystem::perms::group_exec | filesystem::perms::others_exec;
+    if (!error && filesystem::is_regular_file(status) && (status.permissions() & executable) != filesystem::perms::none) {
+      return candidate.string();
+    }
+  }
+  return "";
+}
+
+std::shared_ptr<Directory> getDirectories(const IgnoreFile& ignoreFile, PathArena& paths, const WalkOptions& options, WalkReport& report) {
+  const auto io = BatchIo::create(options.io);
+  WalkState state = {ignoreFile, paths, options, report, *io, {}, {}, {}};
+  enterDirectory(state, ".", false);
+
+  if (options.source == WalkOptions::GitIndex) {
+    const auto gitDirectory = GitIndex::findGitDirectory(".");
+    const auto index = gitDirectory.empty() ? nullptr : GitIndex::open(gitDirectory);
+    auto root = index ? readGitIndex(state, *index, ".", nullptr) : nullptr;
+    if (root) {
+      if (options.includeUntracked) {
+        GitIgnore gitIgnore(gitDirectory);
+        state.gitIgnore = &gitIgnore;
+        addUntrackedFiles(state, *root);
+        walkDeferredSymlinks(state);
+        state.gitIgnore = nullptr;
+      }
+      return root;
+    }
+  }
+
+  auto root = walkDirectory(state, ".", nullptr);
+  walkDeferredSymlinks(state);
+  return root;
+}
+
+void walkProjects(
+  const IgnoreFile& ignoreFile,
+  PathArena& paths,
+  const WalkOptions& options,
+  WalkReport& report,
+  const std::function<void(const Directory&)>& onProject
+) {
+  const auto io = BatchIo::create(options.io);
+  WalkState state = {ignoreFile, paths, options, report, *io, {}, {}, {}};
+  enterDirectory(state, ".", false);
+  streamDirectory(state, ".", nullptr, false, onProject);
 }
 
- DirectoryFiles getFilesForProject(const Directory* directory) {
+DirectoryFiles getFilesForProject(const Directory* directory) {
 
   DirectoryFiles files;
 
-  directory->forEachIf(
-    [&files](const file_utils::Directory& dir) {
-      std::copy(dir.includeFiles().begin(), dir.includeFiles().end(), std::back_inserter(files.includeFiles));
-      std::copy(dir.sourceFiles().begin(), dir.sourceFiles().end(), std::back_inserter(files.sourceFiles));
-    },
-    [&directory](const file_utils::Directory& dir) {
-      return dir.path() == directory->path() || !dir.hasCmakeFile();
+  directory->visitDepthFirst([&files, directory](const Directory& dir) {
+    if (&dir != directory && dir.hasCmakeFile()) {
+      return Directory::SkipChildren;
     }
-  );
+
+    files.includeFiles.insert(files.includeFiles.end(), dir.includeFiles().begin(), dir.includeFiles().end());
+    files.sourceFiles.insert(files.sourceFiles.end(), dir.sourceFiles().begin(), dir.sourceFiles().end());
+    return Directory::Continue;
+  });
 
   std::sort(files.includeFiles.begin(), files.includeFiles.end());
   std::sort(files.sourceFiles.begin(), files.sourceFiles.end());
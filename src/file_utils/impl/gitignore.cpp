@@ -0,0 +1,78 @@
+#include "../gitignore.h"
+#include "../fileutils.h"
+
+#include <fstream>
+
+namespace file_utils {
+
+GitIgnore::GitIgnore(const std::string& gitDirectory)
+  : rules_({}), added_({}) {
+  addRules(gitDirectory + "/info/exclude", ".");
+}
+
+void GitIgnore::addDirectory(const std::string& directory) {
+  if (added_.insert(directory).second) {
+    addRules(directory + "/.gitignore", directory);
+  }
+}
+
+void GitIgnore::addRules(const std::string& file, const std::string& base) {
+  std::ifstream stream(file);
+  for (std::string line; std::getline(stream, line);) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    while (!line.empty() && line.back() == ' ' && (line.size() < 2 || line[line.size() - 2] != '\\')) {
+      line.pop_back();
+    }
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    Rule rule = {base, line, false, false, false};
+    if (rule.pattern[0] == '!') {
+      rule.negated = true;
+      rule.pattern.erase(0, 1);
+    } else if (rule.pattern[0] == '\\') {
+      rule.pattern.erase(0, 1);
+    }
+    if (!rule.pattern.empty() && rule.pattern.back() == '/') {
+      rule.directoryOnly = true;
+      rule.pattern.pop_back();
+    }
+    // a slash anywhere but at the end ties the pattern to the directory of the file
+    rule.anchored = rule.pattern.find('/') != std::string::npos;
+    if (!rule.pattern.empty() && rule.pattern[0] == '/') {
+      rule.pattern.erase(0, 1);
+    }
+    if (!rule.pattern.empty()) {
+      rules_.push_back(std::move(rule));
+    }
+  }
+}
+
+bool GitIgnore::excludes(std::string_view path, bool isDirectory) const {
+  for (auto rule = rules_.rbegin(); rule != rules_.rend(); ++rule) {
+    if (rule->directoryOnly && !isDirectory) {
+      continue;
+    }
+
+    std::string_view relative = path;
+    if (rule->base != ".") {
+      if (path.size() <= rule->base.size() || path.compare(0, rule->base.size(), rule->base) != 0 || path[rule->base.size()] != '/') {
+        continue;
+      }
+      relative = path.substr(rule->base.size() + 1);
+    } else if (relative.substr(0, 2) == "./") {
+      relative = relative.substr(2);
+    }
+
+    const auto name = relative.substr(relative.rfind('/') + 1);
+    if (matchesGlob(rule->pattern, rule->anchored ? relative : name)) {
+      return !rule->negated;
+    }
+  }
+  return false;
+}
+
+}
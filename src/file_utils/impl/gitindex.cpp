@@ -0,0 +1,217 @@
+#include "../gitindex.h"
+#include "../mappedfile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace filesystem = std::filesystem;
+
+namespace file_utils {
+namespace {
+  const size_t HeaderSize = 12;
+  const size_t StatDataSize = 40;
+  const size_t Sha1Size = 20;
+  const size_t Sha256Size = 32;
+  const unsigned int ExtendedFlag = 0x4000;
+  const unsigned int StageMask = 0x3000;
+  const unsigned int OursStage = 0x2000;
+  const unsigned int NameLengthMask = 0x0fff;
+  const unsigned int SkipWorktreeFlag = 0x4000;
+  const unsigned int ModeTypeMask = 0170000;
+  const unsigned int DirectoryMode = 0040000;
+
+  uint32_t readUint32(const unsigned char* data) {
+    return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | uint32_t(data[3]);
+  }
+
+  uint16_t readUint16(const unsigned char* data) {
+    return uint16_t((data[0] << 8) | data[1]);
+  }
+
+  bool readVarint(const unsigned char*& data, const unsigned char* end, size_t& value) {
+    if (data >= end) {
+      return false;
+    }
+
+    unsigned char byte = *data++;
+    value = byte & 0x7f;
+    while (byte & 0x80) {
+      if (data >= end) {
+        return false;
+      }
+      byte = *data++;
+      value = ((value + 1) << 7) | (byte & 0x7f);
+    }
+    return true;
+  }
+
+  size_t hashSizeForRepository(const std::string& gitDirectory) {
+    std::ifstream config(gitDirectory + "/config");
+    for (std::string line; std::getline(config, line);) {
+      if (line.find("objectformat") != std::string::npos && line.find("sha256") != std::string::npos) {
+        return Sha256Size;
+      }
+    }
+    return Sha1Size;
+  }
+}
+
+std::unique_ptr<GitIndex> GitIndex::open(const std::string& gitDirectory) {
+  const auto indexPath = gitDirectory + "/index";
+  auto file = MappedFile::open(indexPath);
+  if (!file || file->size() < HeaderSize) {
+    return nullptr;
+  }
+
+  const auto* data = reinterpret_cast<const unsigned char*>(file->data());
+  if (std::memcmp(data, "DIRC", 4) != 0) {
+    return nullptr;
+  }
+
+  const auto version = readUint32(data + 4);
+  if (version < 2 || version > 4) {
+    return nullptr;
+  }
+
+  const auto entryCount = readUint32(data + 8);
+  std::unique_ptr<GitIndex> index(new GitIndex(indexPath, std::move(file), version, entryCount, hashSizeForRepository(gitDirectory)));
+  // a split index keeps most entries in a shared index file, this one alone is a partial tree
+  if (index->hasExtension("link")) {
+    return nullptr;
+  }
+  return index;
+}
+
+// Extensions follow the entries as a signature, a size and the data, the file ends with its hash.
+bool GitIndex::hasExtension(const char* signature) const {
+  const unsigned char* cursor = nullptr;
+  if (!parseEntries(nullptr, cursor)) {
+    return false;
+  }
+
+  const auto* end = reinterpret_cast<const unsigned char*>(file_->data()) + file_->size() - std::min(file_->size(), hashSize_);
+  while (end - cursor >= 8) {
+    if (std::memcmp(cursor, signature, 4) == 0) {
+      return true;
+    }
+    const auto size = readUint32(cursor + 4);
+    if (static_cast<size_t>(end - cursor - 8) < size) {
+      return false;
+    }
+    cursor += 8 + size;
+  }
+  return false;
+}
+
+std::string GitIndex::findGitDirectory(const std::string& workTree) {
+  const auto dotGit = filesystem::path(workTree) / ".git";
+  std::error_code error;
+  if (filesystem::is_directory(dotGit, error)) {
+    return dotGit.generic_string();
+  }
+
+  std::ifstream stream(dotGit);
+  std::string line;
+  if (!stream.is_open() || !std::getline(stream, line) || line.rfind("gitdir: ", 0) != 0) {
+    return "";
+  }
+
+  auto gitDirectory = filesystem::path(line.substr(8));
+  if (gitDirectory.is_relative()) {
+    gitDirectory = filesystem::path(workTree) / gitDirectory;
+  }
+  return gitDirectory.lexically_normal().generic_string();
+}
+
+GitIndex::GitIndex(const std::string& path, std::unique_ptr<MappedFile> file, unsigned int version, unsigned int entryCount, size_t hashSize)
+  : path_(path), file_(std::move(file)), version_(version), entryCount_(entryCount), hashSize_(hashSize) {
+}
+
+GitIndex::~GitIndex() = default;
+
+const std::string& GitIndex::path() const {
+  return path_;
+}
+
+bool GitIndex::forEachEntry(const std::function<void(const GitIndexEntry& entry)>& callback) const {
+  const unsigned char* cursor = nullptr;
+  return parseEntries(&callback, cursor);
+}
+
+bool GitIndex::parseEntries(const std::function<void(const GitIndexEntry& entry)>* callback, const unsigned char*& cursor) const {
+  const auto* data = reinterpret_cast<const unsigned char*>(file_->data());
+  const auto* end = data + file_->size();
+  cursor = data + HeaderSize;
+
+  std::string previousPath;
+  for (unsigned int i = 0; i < entryCount_; i++) {
+    const auto* entryStart = cursor;
+    if (static_cast<size_t>(end - cursor) < StatDataSize + hashSize_ + 2) {
+      return false;
+    }
+
+    const auto mode = readUint32(cursor + 24);
+    cursor += StatDataSize + hashSize_;
+    const auto flags = readUint16(cursor);
+    cursor += 2;
+
+    unsigned int extendedFlags = 0;
+    if (version_ >= 3 && (flags & ExtendedFlag)) {
+      if (end - cursor < 2) {
+        return false;
+      }
+      extendedFlags = readUint16(cursor);
+      cursor += 2;
+    }
+
+    std::string_view path;
+    if (version_ == 4) {
+      size_t stripLength = 0;
+      if (!readVarint(cursor, end, stripLength) || stripLength > previousPath.size()) {
+        return false;
+      }
+      const auto* suffixEnd = static_cast<const unsigned char*>(std::memchr(cursor, 0, end - cursor));
+      if (!suffixEnd) {
+        return false;
+      }
+      previousPath.resize(previousPath.size() - stripLength);
+      previousPath.append(reinterpret_cast<const char*>(cursor), suffixEnd - cursor);
+      cursor = suffixEnd + 1;
+      path = previousPath;
+    } else {
+      size_t nameLength = flags & NameLengthMask;
+      if (nameLength == NameLengthMask) {
+        const auto* nameEnd = static_cast<const unsigned char*>(std::memchr(cursor, 0, end - cursor));
+        if (!nameEnd) {
+          return false;
+        }
+        nameLength = nameEnd - cursor;
+      }
+      if (static_cast<size_t>(end - cursor) < nameLength + 1) {
+        return false;
+      }
+      path = std::string_view(reinterpret_cast<const char*>(cursor), nameLength);
+
+      const size_t headerLength = cursor - entryStart;
+      cursor = entryStart + ((headerLength + nameLength + 8) & ~size_t(7));
+      if (cursor > end) {
+        return false;
+      }
+    }
+
+    // unmerged paths have an entry per stage, keep only "ours" so every path is reported once
+    const auto stage = flags & StageMask;
+    const bool conflictDuplicate = stage != 0 && stage != OursStage;
+    const bool notInWorktree = (extendedFlags & SkipWorktreeFlag) || (mode & ModeTypeMask) == DirectoryMode;
+    if (callback != nullptr && !conflictDuplicate && !notInWorktree) {
+      (*callback)({path, mode});
+    }
+  }
+
+  return true;
+}
+
+}
@@ -0,0 +1,78 @@
+#include "../mappedfile.h"
+
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FILE_UTILS_HAS_MMAP 1
+#endif
+
+namespace file_utils {
+
+std::unique_ptr<MappedFile> MappedFile::open(const std::string& path) {
+#ifdef FILE_UTILS_HAS_MMAP
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat fileStat;
+  if (::fstat(fd, &fileStat) != 0) {
+    ::close(fd);
+    return nullptr;
+  }
+
+  const size_t size = static_cast<size_t>(fileStat.st_size);
+  if (size == 0) {
+    ::close(fd);
+    return std::unique_ptr<MappedFile>(new MappedFile(nullptr, 0, false));
+  }
+
+  void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+
+  return std::unique_ptr<MappedFile>(new MappedFile(static_cast<const char*>(data), size, true));
+#else
+  std::ifstream stream(path, std::ios::binary);
+  if (!stream.is_open()) {
+    return nullptr;
+  }
+
+  std::vector<char> buffer((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+  return std::unique_ptr<MappedFile>(new MappedFile(std::move(buffer)));
+#endif
+}
+
+MappedFile::MappedFile(const char* data, size_t size, bool mapped)
+  : data_(data), size_(size), mapped_(mapped) {
+}
+
+MappedFile::MappedFile(std::vector<char> buffer)
+  : data_(nullptr), size_(buffer.size()), mapped_(false), buffer_(std::move(buffer)) {
+  data_ = buffer_.data();
+}
+
+MappedFile::~MappedFile() {
+#ifdef FILE_UTILS_HAS_MMAP
+  if (mapped_) {
+    ::munmap(const_cast<char*>(data_), size_);
+  }
+#endif
+}
+
+const char* MappedFile::data() const {
+  return data_;
+}
+
+size_t MappedFile::size() const {
+  return size_;
+}
+
+}
@@ -0,0 +1,68 @@
+#include "../patharena.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+namespace file_utils {
+namespace {
+  const size_t DefaultBlockSize = 64 * 1024;
+}
+
+PathArena PathArena::forCurrentPath() {
+  return PathArena(std::filesystem::current_path().generic_string());
+}
+
+PathArena::PathArena(const std::string& rootPath)
+  : rootPath_(rootPath), blockUsed_(0) {
+}
+
+const std::string& PathArena::rootPath() const {
+  return rootPath_;
+}
+
+std::string PathArena::absolute(std::string_view relativePath) const {
+  if (relativePath.empty() || relativePath == ".") {
+    return rootPath_;
+  }
+
+  return rootPath_ + std::string(relativePath.substr(1));
+}
+
+std::string_view PathArena::add(std::string_view relativePath) {
+  char* data = allocate(relativePath.size());
+  std::memcpy(data, relativePath.data(), relativePath.size());
+  return {data, relativePath.size()};
+}
+
+PathArena::Mark PathArena::mark() const {
+  return {blocks_.size(), blockUsed_};
+}
+
+// Drops every path added after the mark, views into that range must no longer be used.
+void PathArena::rewind(const Mark& mark) {
+  blocks_.resize(mark.blockCount);
+  blockUsed_ = mark.blockUsed;
+}
+
+std::string_view PathArena::relativeTo(std::string_view path, std::string_view directory) {
+  if (path.size() <= directory.size()) {
+    return {};
+  }
+
+  return path.substr(directory.size() + 1);
+}
+
+char* PathArena::allocate(size_t size) {
+  if (blocks_.empty() || blockUsed_ + size > blocks_.back().size) {
+    const auto blockSize = std::max(size, DefaultBlockSize);
+    blocks_.push_back({std::make_unique<char[]>(blockSize), blockSize});
+    blockUsed_ = 0;
+  }
+
+  char* data = blocks_.back().data.get() + blockUsed_;
+  blockUsed_ += size;
+  return data;
+}
+
+}
@@ -0,0 +1,335 @@
+#include "uringbatchio.h"
+
+#ifdef FILE_UTILS_HAS_URING
+#include <linux/io_uring.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+namespace file_utils {
+namespace {
+  const unsigned int RingEntries = 256;
+
+  // the most one read asks for, which keeps the length within what a submission entry holds
+  const unsigned long long ReadChunk = 1ull << 30;
+
+  bool unsupported(int result) {
+    return result == -EINVAL || result == -EOPNOTSUPP || result == -ECANCELED;
+  }
+
+  bool outOfDescriptors(int result) {
+    return result == -EMFILE || result == -ENFILE;
+  }
+
+  FileStatus toFileStatus(const struct statx& status) {
+    return {
+      true,
+      S_ISDIR(status.stx_mode),
+      static_cast<unsigned long long>(makedev(status.stx_dev_major, status.stx_dev_minor)),
+      static_cast<unsigned long long>(status.stx_ino),
+      static_cast<unsigned long long>(status.stx_size),
+      static_cast<unsigned long long>(status.stx_mtime.tv_sec) * 1000000000ull + status.stx_mtime.tv_nsec
+    };
+  }
+
+  void prepareStatx(io_uring_sqe& sqe, const std::string& path, struct statx& status) {
+    sqe.opcode = IORING_OP_STATX;
+    sqe.fd = AT_FDCWD;
+    sqe.addr = reinterpret_cast<unsigned long long>(path.c_str());
+    sqe.len = STATX_TYPE | STATX_INO | STATX_SIZE | STATX_MTIME;
+    sqe.off = reinterpret_cast<unsigned long long>(&status);
+  }
+}
+
+std::unique_ptr<UringBatchIo> UringBatchIo::create() {
+  std::unique_ptr<UringBatchIo> io(new UringBatchIo());
+  if (!io->setup(RingEntries)) {
+    return nullptr;
+  }
+  return io;
+}
+
+UringBatchIo::UringBatchIo()
+  : ringFd_(-1), entries_(0), submissionRing_(MAP_FAILED), completionRing_(MAP_FAILED), submissionRingSize_(0),
+  completionRingSize_(0), submissionEntries_(nullptr), submissionEntriesSize_(0), submissionTail_(nullptr),
+  submissionMask_(nullptr), submissionArray_(nullptr), completionHead_(nullptr), completionTail_(nullptr),
+  completionMask_(nullptr), completionEntries_(nullptr), broken_(false) {
+}
+
+UringBatchIo::~UringBatchIo() {
+  if (submissionEntries_) {
+    ::munmap(submissionEntries_, submissionEntriesSize_);
+  }
+  if (completionRing_ != MAP_FAILED && completionRing_ != submissionRing_) {
+    ::munmap(completionRing_, completionRingSize_);
+  }
+  if (submissionRing_ != MAP_FAILED) {
+    ::munmap(submissionRing_, submissionRingSize_);
+  }
+  if (ringFd_ >= 0) {
+    ::close(ringFd_);
+  }
+}
+
+const char* UringBatchIo::name() const {
+  return "io_uring";
+}
+
+bool UringBatchIo::setup(unsigned int entries) {
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  ringFd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+  if (ringFd_ < 0) {
+    return false;
+  }
+
+  entries_ = params.sq_entries;
+  submissionRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  completionRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool singleMapping = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (singleMapping) {
+    submissionRingSize_ = std::max(submissionRingSize_, completionRingSize_);
+    completionRingSize_ = submissionRingSize_;
+  }
+
+  submissionRing_ = ::mmap(nullptr, submissionRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+  if (submissionRing_ == MAP_FAILED) {
+    return false;
+  }
+
+  completionRing_ = singleMapping ? submissionRing_ :
+    ::mmap(nullptr, completionRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+  if (completionRing_ == MAP_FAILED) {
+    return false;
+  }
+
+  submissionEntriesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* submissionEntries = ::mmap(nullptr, submissionEntriesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+  if (submissionEntries == MAP_FAILED) {
+    return false;
+  }
+  submissionEntries_ = static_cast<io_uring_sqe*>(submissionEntries);
+
+  auto* submission = static_cast<char*>(submissionRing_);
+  submissionTail_ = reinterpret_cast<unsigned int*>(submission + params.sq_off.tail);
+  submissionMask_ = reinterpret_cast<unsigned int*>(submission + params.sq_off.ring_mask);
+  submissionArray_ = reinterpret_cast<unsigned int*>(submission + params.sq_off.array);
+
+  auto* completion = static_cast<char*>(completionRing_);
+  completionHead_ = reinterpret_cast<unsigned int*>(completion + params.cq_off.head);
+  completionTail_ = reinterpret_cast<unsigned int*>(completion + params.cq_off.tail);
+  completionMask_ = reinterpret_cast<unsigned int*>(completion + params.cq_off.ring_mask);
+  completionEntries_ = reinterpret_cast<io_uring_cqe*>(completion + params.cq_off.cqes);
+
+  return true;
+}
+
+// Queues up to a ring's worth of requests at a time and waits for all of them with a single enter call.
+bool UringBatchIo::submit(size_t count, const std::function<void(io_uring_sqe& sqe, size_t index)>& prepare, std::vector<int>& results) {
+  results.assign(count, -ECANCELED);
+  if (broken_) {
+    return false;
+  }
+
+  for (size_t start = 0; start < count; start += entries_) {
+    const auto batch = static_cast<unsigned int>(std::min<size_t>(entries_, count - start));
+
+    unsigned int tail = *submissionTail_;
+    for (unsigned int i = 0; i < batch; i++) {
+      const unsigned int slot = tail & *submissionMask_;
+      auto& sqe = submissionEntries_[slot];
+      std::memset(&sqe, 0, sizeof(sqe));
+      prepare(sqe, start + i);
+      sqe.user_data = start + i;
+      submissionArray_[slot] = slot;
+      tail++;
+    }
+    __atomic_store_n(submissionTail_, tail, __ATOMIC_RELEASE);
+
+    unsigned int submitted = 0;
+    unsigned int completed = 0;
+    const auto reap = [&]() {
+      unsigned int head = *completionHead_;
+      const unsigned int completionTail = __atomic_load_n(completionTail_, __ATOMIC_ACQUIRE);
+      while (head != completionTail) {
+        const auto& cqe = completionEntries_[head & *completionMask_];
+        results[cqe.user_data] = cqe.res;
+        head++;
+        completed++;
+      }
+      __atomic_store_n(completionHead_, head, __ATOMIC_RELEASE);
+    };
+    while (completed < batch) {
+      const long entered = ::syscall(__NR_io_uring_enter, ringFd_, batch - submitted, batch - completed, IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (entered < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        broken_ = true;
+        // the requests in flight still complete, an opened file is only closed once its completion is read
+        while (completed < submitted) {
+          const auto before = completed;
+          reap();
+          const long waited = completed < submitted
+            ? ::syscall(__NR_io_uring_enter, ringFd_, 0, submitted - completed, IORING_ENTER_GETEVENTS, nullptr, 0) : 0;
+          if (waited < 0 && errno != EINTR && completed == before) {
+            break;
+          }
+        }
+        return false;
+      }
+      submitted += static_cast<unsigned int>(entered);
+      reap();
+    }
+  }
+
+  return true;
+}
+
+std::vector<FileStatus> UringBatchIo::stat(const std::vector<std::string>& paths) {
+  std::vector<struct statx> buffers(paths.size());
+  std::vector<int> results = {};
+  submit(paths.size(), [&paths, &buffers](io_uring_sqe& sqe, size_t index) {
+    prepareStatx(sqe, paths[index], buffers[index]);
+  }, results);
+
+  std::vector<FileStatus> statuses = {};
+  statuses.reserve(paths.size());
+  for (size_t i = 0; i < paths.size(); i++) {
+    if (results[i] == 0) {
+      statuses.push_back(toFileStatus(buffers[i]));
+    } else if (unsupported(results[i])) {
+      statuses.push_back(SyncBatchIo::statFile(paths[i]));
+    } else {
+      statuses.push_back({false, false, 0, 0, 0, 0});
+    }
+  }
+  return statuses;
+}
+
+std::vector<FileContents> UringBatchIo::readFiles(const std::vector<std::string>& paths) {
+  return read(paths, std::numeric_limits<unsigned long long>::max());
+}
+
+std::vector<FileContents> UringBatchIo::readPrefixes(const std::vector<std::string>& paths, unsigned long long maxBytes) {
+  return read(paths, maxBytes);
+}
+
+std::vector<FileContents> UringBatchIo::read(const std::vector<std::string>& paths, unsigned long long maxBytes) {
+  std::vector<FileContents> contents(paths.size(), {false, ""});
+  const auto window = openWindow();
+  for (size_t start = 0; start < paths.size(); start += window) {
+    readWindow(paths, start, std::min(paths.size(), start + window), maxBytes, contents);
+  }
+  return contents;
+}
+
+// Only a window of files is open at a time, every one of them is closed before the next window opens.
+void UringBatchIo::readWindow(
+  const std::vector<std::string>& paths,
+  size_t start,
+  size_t end,
+  unsigned long long maxBytes,
+  std::vector<FileContents>& contents
+) {
+  const auto count = end - start;
+  std::vector<struct statx> buffers(count);
+  std::vector<int> openResults = {};
+  submit(count * 2, [&paths, &buffers, start](io_uring_sqe& sqe, size_t index) {
+    const auto& path = paths[start + index / 2];
+    if (index % 2 == 0) {
+      prepareStatx(sqe, path, buffers[index / 2]);
+      return;
+    }
+    sqe.opcode = IORING_OP_OPENAT;
+    sqe.fd = AT_FDCWD;
+    sqe.addr = reinterpret_cast<unsigned long long>(path.c_str());
+    sqe.open_flags = O_RDONLY | O_CLOEXEC;
+  }, openResults);
+
+  // files the ring can't serve are read synchronously once the window's descriptors are closed again
+  std::vector<size_t> fallback = {};
+  std::vector<size_t> pending = {};
+  std::vector<unsigned long long> offsets(count, 0);
+  for (size_t i = 0; i < count; i++) {
+    const int statResult = openResults[i * 2];
+    const int fd = openResults[i * 2 + 1];
+    if (unsupported(statResult) || unsupported(fd) || outOfDescriptors(fd)) {
+      fallback.push_back(i);
+    } else if (fd >= 0 && statResult == 0) {
+      contents[start + i].ok = true;
+      contents[start + i].data.resize(static_cast<size_t>(std::min<unsigned long long>(buffers[i].stx_size, maxBytes)));
+      if (!contents[start + i].data.empty()) {
+        pending.push_back(i);
+      }
+    }
+  }
+
+  // short reads are continued where they stopped, large files take several reads of at most ReadChunk bytes
+  while (!pending.empty()) {
+    std::vector<int> readResults = {};
+    submit(pending.size(), [&](io_uring_sqe& sqe, size_t index) {
+      const auto file = pending[index];
+      auto& data = contents[start + file].data;
+      sqe.opcode = IORING_OP_READ;
+      sqe.fd = openResults[file * 2 + 1];
+      sqe.addr = reinterpret_cast<unsigned long long>(data.data() + offsets[file]);
+      sqe.len = static_cast<unsigned int>(std::min<unsigned long long>(data.size() - offsets[file], ReadChunk));
+      sqe.off = offsets[file];
+    }, readResults);
+
+    std::vector<size_t> unfinished = {};
+    for (size_t i = 0; i < pending.size(); i++) {
+      const auto file = pending[i];
+      auto& fileContents = contents[start + file];
+      if (readResults[i] == -EINTR || readResults[i] == -EAGAIN) {
+        unfinished.push_back(file);
+      } else if (unsupported(readResults[i])) {
+        fallback.push_back(file);
+      } else if (readResults[i] < 0) {
+        fileContents = {false, ""};
+      } else if (readResults[i] == 0) {
+        // the file got shorter since it was looked at
+        fileContents.data.resize(static_cast<size_t>(offsets[file]));
+      } else {
+        offsets[file] += static_cast<unsigned long long>(readResults[i]);
+        if (offsets[file] < fileContents.data.size()) {
+          unfinished.push_back(file);
+        }
+      }
+    }
+    pending.swap(unfinished);
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    if (openResults[i * 2 + 1] >= 0) {
+      ::close(openResults[i * 2 + 1]);
+    }
+  }
+  for (const auto file : fallback) {
+    contents[start + file] = SyncBatchIo::readPrefix(paths[start + file], maxBytes);
+  }
+}
+
+// As many files as the ring takes at once, but no more than a quarter of the descriptors the
+// process may still open, which leaves the rest of the program room for its own.
+size_t UringBatchIo::openWindow() const {
+  size_t window = entries_;
+  struct rlimit limit;
+  if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+    window = std::min<size_t>(window, static_cast<size_t>(limit.rlim_cur / 4));
+  }
+  return std::max<size_t>(window, 1);
+}
+}
+
+#endif
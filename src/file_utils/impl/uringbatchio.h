@@ -0,0 +1,68 @@
+#ifndef FILE_UTILS_URINGBATCHIO_H
+#define FILE_UTILS_URINGBATCHIO_H
+
+#if defined(__linux__) && defined(__has_include) && !defined(CMAKEGEN_WITHOUT_IO_URING)
+#if __has_include(<linux/io_uring.h>)
+#define FILE_UTILS_HAS_URING 1
+#endif
+#endif
+
+#ifdef FILE_UTILS_HAS_URING
+#include "../batchio.h"
+
+#include <functional>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace file_utils {
+
+// io_uring backend talking to the kernel directly, so it needs no liburing. create() returns
+// nullptr when the kernel refuses to set up a ring and requests the ring can't serve fall back to sync calls.
+class UringBatchIo : public BatchIo {
+public:
+  static std::unique_ptr<UringBatchIo> create();
+
+  ~UringBatchIo() override;
+  const char* name() const override;
+  std::vector<FileStatus> stat(const std::vector<std::string>& paths) override;
+  std::vector<FileContents> readFiles(const std::vector<std::string>& paths) override;
+  std::vector<FileContents> readPrefixes(const std::vector<std::string>& paths, unsigned long long maxBytes) override;
+
+private:
+  UringBatchIo();
+  bool setup(unsigned int entries);
+  std::vector<FileContents> read(const std::vector<std::string>& paths, unsigned long long maxBytes);
+  void readWindow(
+    const std::vector<std::string>& paths,
+    size_t start,
+    size_t end,
+    unsigned long long maxBytes,
+    std::vector<FileContents>& contents
+  );
+  size_t openWindow() const;
+  bool submit(size_t count, const std::function<void(io_uring_sqe& sqe, size_t index)>& prepare, std::vector<int>& results);
+
+  int ringFd_;
+  unsigned int entries_;
+  void* submissionRing_;
+  void* completionRing_;
+  size_t submissionRingSize_;
+  size_t completionRingSize_;
+  io_uring_sqe* submissionEntries_;
+  size_t submissionEntriesSize_;
+  unsigned int* submissionTail_;
+  unsigned int* submissionMask_;
+  unsigned int* submissionArray_;
+  unsigned int* completionHead_;
+  unsigned int* completionTail_;
+  unsigned int* completionMask_;
+  io_uring_cqe* completionEntries_;
+  bool broken_;
+};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef FILE_UTILS_MAPPEDFILE_H
+#define FILE_UTILS_MAPPEDFILE_H
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace file_utils {
+
+// Read-only view of a whole file, memory mapped where the platform supports it.
+class MappedFile {
+public:
+  static std::unique_ptr<MappedFile> open(const std::string& path);
+
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const;
+  size_t size() const;
+
+private:
+  MappedFile(const char* data, size_t size, bool mapped);
+  MappedFile(std::vector<char> buffer);
+
+  const char* data_;
+  size_t size_;
+  bool mapped_;
+  std::vector<char> buffer_;
+};
+
+}
+
+#endif
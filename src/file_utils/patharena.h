@@ -0,0 +1,51 @@
+#ifndef FILE_UTILS_PATHARENA_H
+#define FILE_UTILS_PATHARENA_H
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace file_utils {
+
+// Owns every path found while walking the project, stored relative to the root as "./dir/file".
+// Storage is allocated in blocks that never move, so returned views stay valid until they are rewound.
+class PathArena {
+public:
+  struct Mark {
+    size_t blockCount;
+    size_t blockUsed;
+  };
+
+  static PathArena forCurrentPath();
+
+  PathArena(const std::string& rootPath);
+  PathArena(PathArena&&) = default;
+  PathArena& operator=(PathArena&&) = default;
+  PathArena(const PathArena&) = delete;
+  PathArena& operator=(const PathArena&) = delete;
+
+  const std::string& rootPath() const;
+  std::string absolute(std::string_view relativePath) const;
+
+  std::string_view add(std::string_view relativePath);
+  Mark mark() const;
+  void rewind(const Mark& mark);
+
+  static std::string_view relativeTo(std::string_view path, std::string_view directory);
+
+private:
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size;
+  };
+
+  char* allocate(size_t size);
+
+  std::string rootPath_;
+  std::vector<Block> blocks_;
+  size_t blockUsed_;
+};
+
+}
+
+#endif
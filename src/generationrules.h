@@ -0,0 +1,36 @@
+#ifndef GENERATIONRULES_H
+#define GENERATIONRULES_H
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Answers to the questions of -g given up front, so whole trees can be generated without prompts.
+// A rules file has one rule per line, "project", "exe" or "lib" followed by a glob on directory
+// paths relative to the root. The first exe or lib rule matching a project decides its type, projects
+// no rule matches are executables when one of their sources defines main().
+class GenerationRules {
+public:
+  enum ProjectType { Library, Executable, DetectMain };
+
+  // Returns false with a message in error when a line can't be parsed, a missing file is no error.
+  static bool load(const std::string& fileName, GenerationRules& rules, std::string& error);
+
+  void addProjects(const std::string& pattern);
+  void addType(const std::string& pattern, ProjectType type);
+
+  bool hasProjects() const;
+  bool isProject(std::string_view path) const;
+  ProjectType projectType(std::string_view path) const;
+
+private:
+  std::vector<std::string> projects_;
+  std::vector<std::pair<std::string, ProjectType>> types_;
+};
+
+// Looks for a definition of main() in C or C++ source, comments and strings aren't told apart.
+bool definesMain(std::string_view source);
+
+// A source named main is taken at its word, it's the common layout and spares reading the sources.
+bool hasMainSourceName(std::string_view file);
+
+#endif
@@ -0,0 +1,189 @@
+#include "../buildreport.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+namespace {
+  struct TargetTotal {
+    unsigned long long milliseconds = 0;
+    unsigned long long longestCompile = 0;
+    unsigned long long link = 0;
+    unsigned int compiles = 0;
+    unsigned int links = 0;
+  };
+
+  unsigned long long duration(const NinjaLogEntry& entry) {
+    return entry.end > entry.start ? entry.end - entry.start : 0;
+  }
+
+  bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+
+  bool isCompile(const std::string& output) {
+    return endsWith(output, ".o") || endsWith(output, ".obj");
+  }
+
+  // cmake puts the objects of a target in CMakeFiles/<target>.dir/ and names the binary after the target
+  std::string targetName(const std::string& output) {
+    if (isCompile(output)) {
+      const auto directory = output.find("CMakeFiles/");
+      const auto end = output.find(".dir/", directory);
+      if (directory == std::string::npos || end == std::string::npos) {
+        return "other";
+      }
+      const auto start = directory + std::string("CMakeFiles/").size();
+      return output.substr(start, end - start);
+    }
+
+    if (output == "build.ninja") {
+      return "cmake";
+    }
+
+    auto name = output.substr(output.find_last_of('/') + 1);
+    for (const auto& extension : {".a", ".so", ".dylib", ".lib", ".dll", ".exe"}) {
+      if (endsWith(name, extension)) {
+        name.erase(name.size() - std::string(extension).size());
+        if (name.compare(0, 3, "lib") == 0 && name.size() > 3 && std::string(extension) != ".exe") {
+          name.erase(0, 3);
+        }
+        break;
+      }
+    }
+    return name;
+  }
+
+  void writeSlowest(std::vector<std::string>& lines, const std::string& title, std::vector<const NinjaLogEntry*> edges, size_t top) {
+    if (edges.empty()) {
+      return;
+    }
+
+    const auto count = std::min(top, edges.size());
+    std::partial_sort(edges.begin(), edges.begin() + count, edges.end(), [](const NinjaLogEntry* a, const NinjaLogEntry* b) {
+      return duration(*a) > duration(*b);
+    });
+
+    lines.push_back(title);
+    for (size_t i = 0; i < count; i++) {
+      lines.push_back("  " + std::to_string(duration(*edges[i])) + " ms " + edges[i]->output);
+    }
+  }
+}
+
+BuildReport::BuildReport(std::vector<NinjaLogEntry> entries, bool rewritten)
+  : entries_(std::move(entries)), rewritten_(rewritten) {
+}
+
+BuildReport BuildReport::readNinjaLog(const std::string& path, const file_utils::FileStatus& before) {
+  const auto after = file_utils::SyncBatchIo::statFile(path);
+  if (!after.exists) {
+    return BuildReport({}, false);
+  }
+
+  // a log that was there before and isn't the same file grown is a recompacted one
+  const bool appended = before.exists && before.device == after.device && before.inode == after.inode && before.size <= after.size;
+  if (before.exists && !appended) {
+    return BuildReport({}, true);
+  }
+  std::ifstream log(path, std::ios::binary);
+  if (appended) {
+    log.seekg(static_cast<std::streamoff>(before.size));
+  }
+
+  // every line is start, end, mtime, output and command hash separated by tabs
+  std::vector<NinjaLogEntry> entries = {};
+  std::string line;
+  while (std::getline(log, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    const auto endTab = line.find('\t');
+    const auto mtimeTab = line.find('\t', endTab + 1);
+    const auto outputTab = line.find('\t', mtimeTab + 1);
+    const auto hashTab = line.find('\t', outputTab + 1);
+    if (endTab == std::string::npos || mtimeTab == std::string::npos || outputTab == std::string::npos || hashTab == std::string::npos) {
+      continue;
+    }
+
+    entries.push_back({
+      std::strtoull(line.c_str(), nullptr, 10),
+      std::strtoull(line.c_str() + endTab + 1, nullptr, 10),
+      line.substr(outputTab + 1, hashTab - outputTab - 1)
+    });
+  }
+
+  return BuildReport(std::move(entries), false);
+}
+
+std::vector<std::string> BuildReport::describe(size_t top, unsigned int jobs) const {
+  if (rewritten_) {
+    return {"Build report: ninja rewrote .ninja_log during the build, its entries can't be told apart from earlier builds"};
+  }
+  if (entries_.empty()) {
+    return {"Build report: ninja had nothing to do"};
+  }
+
+  unsigned long long firstStart = entries_.front().start;
+  unsigned long long lastEnd = 0;
+  unsigned long long cpu = 0;
+  std::vector<const NinjaLogEntry*> compiles = {};
+  std::vector<const NinjaLogEntry*> links = {};
+  std::map<std::string, TargetTotal> targets = {};
+  for (const auto& entry : entries_) {
+    firstStart = std::min(firstStart, entry.start);
+    lastEnd = std::max(lastEnd, entry.end);
+    cpu += duration(entry);
+
+    auto& target = targets[targetName(entry.output)];
+    target.milliseconds += duration(entry);
+    if (isCompile(entry.output)) {
+      compiles.push_back(&entry);
+      target.compiles++;
+      target.longestCompile = std::max(target.longestCompile, duration(entry));
+    } else {
+      links.push_back(&entry);
+      target.links++;
+      target.link += duration(entry);
+    }
+  }
+
+  // the log has no dependencies, but a link always waits for its slowest object
+  std::string criticalTarget;
+  unsigned long long criticalPath = 0;
+  for (const auto& target : targets) {
+    if (target.second.longestCompile + target.second.link > criticalPath) {
+      criticalPath = target.second.longestCompile + target.second.link;
+      criticalTarget = target.first;
+    }
+  }
+
+  const auto wall = std::max(1ULL, lastEnd - firstStart);
+  std::ostringstream summary;
+  summary << "Build report: " << entries_.size() << " edges, wall " << wall << " ms, CPU " << cpu << " ms, parallelism "
+          << std::fixed << std::setprecision(1) << static_cast<double>(cpu) / static_cast<double>(wall) << " of " << jobs << " jobs";
+  std::vector<std::string> lines = {summary.str()};
+  lines.push_back("Critical path at least " + std::to_string(criticalPath) + " ms (slowest compile and link of " + criticalTarget + ")");
+
+  writeSlowest(lines, "Slowest compiles:", compiles, top);
+  writeSlowest(lines, "Slowest links:", links, top);
+
+  std::vector<std::pair<std::string, TargetTotal>> totals(targets.begin(), targets.end());
+  std::stable_sort(totals.begin(), totals.end(), [](const auto& a, const auto& b) {
+    return a.second.milliseconds > b.second.milliseconds;
+  });
+  lines.push_back("Targets:");
+  for (size_t i = 0; i < std::min(top, totals.size()); i++) {
+    const auto& total = totals[i].second;
+    lines.push_back(
+      "  " + std::to_string(total.milliseconds) + " ms " + totals[i].first + " (" + std::to_string(total.compiles) + " compiles, " +
+      std::to_string(total.links) + " links)"
+    );
+  }
+
+  return lines;
+}
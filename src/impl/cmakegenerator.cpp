@@ -1,14 +1,19 @@
 #include "../cmakegenerator.h"
+#include "../analysis/includescanner.h"
 #include "../file_utils/fileutils.h"
 #include "../file_utils/directory.h"
 #include "../cmake/cmakefile.h"
+#include "../cmake/managedsection.h"
+#include "../generationrules.h"
 #include "../iohandler.h"
+#include "../projectdetection.h"
+#include "../threadpool.h"
 
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <chrono>
 #include <set>
-#include <queue>
 
 namespace {
 
@@ -73,47 +78,32 @@ std::string getOptionalInput(const std::string& input, const std::string& defaul
   return input.empty() ? defaultValue : input;
 }
 
-std::string getProjectType(IoHandler& ioHandler) {
-  auto input = lowercase(ioHandler.input());
+std::string getProjectType(IoHandler& ioHandler, const std::string& defaultType) {
+  auto input = getOptionalInput(lowercase(ioHandler.input()), defaultType);
   while (input != "lib" && input != "exe") {
-    input = input = lowercase(ioHandler.input());
+    input = getOptionalInput(lowercase(ioHandler.input()), defaultType);
   }
 
   return input;
 }
 
-std::vector<const file_utils::Directory*> getSubDirectoriesForProject(const file_utils::Directory* directory) {
-  std::vector<const file_utils::Directory*> subDirectories = {};
-  directory->forEach([&subDirectories, directory](const file_utils::Directory& dir) {
-    if (dir.path() != directory->path() && dir.hasCmakeFile()) {
-      subDirectories.push_back(&dir);
-    }
-  });
-
-  return subDirectories;
-}
-
 }
 
 CmakeGenerator::CmakeGenerator(
   IoHandler& iohandler,
   const file_utils::IgnoreFile& ignoreFile,
-  const std::string& cmakeVersion,
-  const std::string& cppVersion
-): defaultCmakeVersion_(cmakeVersion), defaultCppVersion_(cppVersion), ioHandler_(iohandler),  ignoreFile_(ignoreFile) {
+  const file_utils::WalkOptions& walkOptions,
+  const CmakeGeneratorOptions& options
+): options_(options), ioHandler_(iohandler),  ignoreFile_(ignoreFile),
+  walkOptions_(walkOptions), paths_(file_utils::PathArena::forCurrentPath()), traversal_({}) {
 }
 
 void CmakeGenerator::run() {
   ioHandler_.write("Welcome to cmakgen\n");
   ioHandler_.write("This tool will guide you through the process of configuring all the CMakeLists.txt files needed for your project\n");
 
-  auto directoryRoot = file_utils::getDirectories(ignoreFile_);
-
-  const auto cmakeDirectories = directoryRoot->filter([](const file_utils::Directory& directory){
-    return directory.hasCmakeFile();
-  });
-  if (!cmakeDirectories.empty()) {
-    ioHandler_.write("Found CMakeLists.txt files in the project, please use -b instead to update them.");
+  auto directoryRoot = walk();
+  if (!directoryRoot) {
     return;
   }
 
@@ -123,23 +113,122 @@ void CmakeGenerator::run() {
 
 }
 
+int CmakeGenerator::runBatch(const GenerationRules& rules) {
+  const auto start = std::chrono::steady_clock::now();
+  auto directoryRoot = walk();
+  if (!directoryRoot) {
+    return 1;
+  }
+
+  // the root always gets a CMakeLists.txt so every project is reachable through add_subdirectory
+  std::vector<const file_utils::Directory*> projects = {};
+  directoryRoot->visitBreadthFirst([&projects, &rules, &directoryRoot](file_utils::Directory& directory) {
+    if (&directory == directoryRoot.get() || rules.isProject(directory.path())) {
+      directory.addCmakeFile();
+      projects.push_back(&directory);
+    }
+  }, traversal_);
+
+  ThreadPool pool(0);
+  std::vector<file_utils::DirectoryFiles> files(projects.size());
+  std::vector<ProjectType> types(projects.size(), Library);
+  pool.forEach(projects.size(), [&](size_t i) {
+    files[i] = file_utils::getFilesForProject(projects[i]);
+    if (rules.projectType(projects[i]->path()) == GenerationRules::Executable) {
+      types[i] = Executable;
+    }
+  });
+
+  // the projects no rule decides on are executables when one of their sources defines main()
+  std::vector<size_t> undecided = {};
+  std::vector<const file_utils::Directory*> undecidedProjects = {};
+  std::vector<file_utils::DirectoryFiles> undecidedFiles = {};
+  for (size_t i = 0; i < projects.size(); i++) {
+    if (rules.projectType(projects[i]->path()) == GenerationRules::DetectMain) {
+      undecided.push_back(i);
+      undecidedProjects.push_back(projects[i]);
+      undecidedFiles.push_back(files[i]);
+    }
+  }
+  const auto hasMain = detectExecutables(
+    undecidedProjects, undecidedFiles, options_.detection, *file_utils::BatchIo::create(walkOptions_.io), pool
+  );
+  for (size_t i = 0; i < undecided.size(); i++) {
+    if (hasMain[i]) {
+      types[undecided[i]] = Executable;
+    }
+  }
+
+  const auto projectAnalyses = analyzeProjects(projects, files, types);
+  pool.forEach(projects.size(), [&](size_t i) {
+    populateCmakeFile(projects[i], files[i], types[i], projectAnalyses[i], options_.cmakeVersion, options_.cppVersion);
+  });
+
+  size_t executables = 0;
+  size_t libraries = 0;
+  for (size_t i = 0; i < projects.size(); i++) {
+    if (!files[i].empty()) {
+      (types[i] == Executable ? executables : libraries)++;
+    }
+  }
+  const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  std::stringstream ss;
+  ss << "Generated " << projects.size() << " CMakeLists.txt files (" << executables << " executables, "
+    << libraries << " libraries) in " << static_cast<long long>(elapsed) << " ms";
+  ioHandler_.write(ss.str());
+  return 0;
+}
+
+std::shared_ptr<file_utils::Directory> CmakeGenerator::walk() {
+  file_utils::WalkReport walkReport;
+  auto directoryRoot = file_utils::getDirectories(ignoreFile_, paths_, walkOptions_, walkReport);
+  for (const auto& line : walkReport.describe()) {
+    ioHandler_.write(line);
+  }
+
+  const bool hasCmakeFiles = !directoryRoot->visitDepthFirst([](const file_utils::Directory& directory) {
+    return directory.hasCmakeFile() ? file_utils::Directory::Stop : file_utils::Directory::Continue;
+  });
+  if (hasCmakeFiles) {
+    ioHandler_.write("Found CMakeLists.txt files in the project, please use -b instead to update them.");
+    return nullptr;
+  }
+  return directoryRoot;
+}
+
 void CmakeGenerator::placeInitialCmakeFiles(const std::shared_ptr<file_utils::Directory>& directoryRoot) {
   std::stringstream ss;
   ss << "Found the following folders, please specify which should be considered projects (contain CMakeLists.txt):\n";
 
   std::vector<file_utils::Directory*> allowedDirectories = {};
-  directoryRoot->forEach([&allowedDirectories, &ss](file_utils::Directory& directory){
+  directoryRoot->visitBreadthFirst([&allowedDirectories, &ss](file_utils::Directory& directory){
     allowedDirectories.push_back(&directory);
-    ss << allowedDirectories.size() << " " << file_utils::makeRelative(directory.path()) << "\n";
-  });
+    ss << allowedDirectories.size() << " " << directory.path() << "\n";
+  }, traversal_);
+
+  // the proposal is the answer given by just pressing enter
+  const auto proposed = proposeProjects(*directoryRoot);
+  std::vector<int> proposedIndices = {};
+  std::string proposal = "";
+  for (size_t i = 0; i < allowedDirectories.size(); i++) {
+    if (std::find(proposed.begin(), proposed.end(), allowedDirectories[i]) != proposed.end()) {
+      proposedIndices.push_back(static_cast<int>(i));
+      proposal += (proposal.empty() ? "" : " ") + std::to_string(i + 1);
+    }
+  }
 
-  ss << "==> Folders to create CMakeLists.txt in (ex: (N)one, 1 2 3 or 1-3)";
+  ss << "==> Folders to create CMakeLists.txt in (ex: (N)one, 1 2 3 or 1-3) (" << proposal << ")";
   ioHandler_.write(ss.str());
 
   bool hasSelectedFiles = false;
   std::vector<int> indices = {};
   while(!hasSelectedFiles) {
     const auto input = lowercase(ioHandler_.input());
+    if (input.empty()) {
+      indices = proposedIndices;
+      hasSelectedFiles = true;
+      continue;
+    }
     if (input.find("n") != std::string::npos) {
       hasSelectedFiles = true;
       continue;
@@ -156,36 +245,151 @@ void CmakeGenerator::placeInitialCmakeFiles(const std::shared_ptr<file_utils::Di
 
   for (const auto& index : indices) {
     allowedDirectories[index]->addCmakeFile();
-    std::ofstream file(allowedDirectories[index]->path() + "/CMakeLists.txt");
+    std::ofstream file(std::string(allowedDirectories[index]->path()) + "/CMakeLists.txt");
     file.close();
   }
 }
 
 void CmakeGenerator::populateCmakeFiles(const std::shared_ptr<file_utils::Directory>& directoryRoot) {
   directoryRoot->hasCmakeFile();
-  ioHandler_.write("CMake version? (" + defaultCmakeVersion_ + ")");
-  const auto cmakeVersion = getOptionalInput(ioHandler_.input(), defaultCmakeVersion_);
+  ioHandler_.write("CMake version? (" + options_.cmakeVersion + ")");
+  const auto cmakeVersion = getOptionalInput(ioHandler_.input(), options_.cmakeVersion);
 
-  ioHandler_.write("C++ version? (" + defaultCppVersion_ + ")");
-  const auto cppVersion = getOptionalInput(ioHandler_.input(), defaultCppVersion_);
+  ioHandler_.write("C++ version? (" + options_.cppVersion + ")");
+  const auto cppVersion = getOptionalInput(ioHandler_.input(), options_.cppVersion);
 
-  const auto cmakeDirectories = directoryRoot->filter([](const file_utils::Directory& directory){
-    return directory.hasCmakeFile();
-  });
+  // populating asks for the project type, the directories are taken level by level to keep the questions in listing order
+  std::vector<const file_utils::Directory*> cmakeDirectories = {};
+  directoryRoot->visitBreadthFirst([&cmakeDirectories](const file_utils::Directory& directory) {
+    if (directory.hasCmakeFile()) {
+      cmakeDirectories.push_back(&directory);
+    }
+  }, traversal_);
 
+  std::vector<file_utils::DirectoryFiles> files = {};
   for (const auto* directory : cmakeDirectories) {
-    populateCmakeFile(directory, cmakeVersion, cppVersion);
+    files.push_back(file_utils::getFilesForProject(directory));
+  }
+  const auto executables = detectExecutables(
+    cmakeDirectories, files, options_.detection, *file_utils::BatchIo::create(walkOptions_.io), ThreadPool(0)
+  );
+
+  std::vector<ProjectType> types(cmakeDirectories.size(), Library);
+  for (size_t i = 0; i < cmakeDirectories.size(); i++) {
+    if (!files[i].empty()) {
+      const auto projectName = file_utils::directoryName(paths_.absolute(cmakeDirectories[i]->path()));
+      const std::string detected = executables[i] ? "exe" : "lib";
+      ioHandler_.write("Found source files for " + projectName + " what should the project type be? (lib/exe) (" + detected + ")");
+      types[i] = getProjectType(ioHandler_, detected) == "lib" ? Library : Executable;
+    }
+  }
+
+  const auto projectAnalyses = analyzeProjects(cmakeDirectories, files, types);
+  for (size_t i = 0; i < cmakeDirectories.size(); i++) {
+    populateCmakeFile(cmakeDirectories[i], files[i], types[i], projectAnalyses[i], cmakeVersion, cppVersion);
+  }
+}
+
+std::vector<CmakeGenerator::ProjectAnalysis> CmakeGenerator::analyzeProjects(
+  const std::vector<const file_utils::Directory*>& projects,
+  const std::vector<file_utils::DirectoryFiles>& files,
+  const std::vector<ProjectType>& types
+) {
+  std::vector<ProjectModel> models(projects.size());
+  for (size_t i = 0; i < projects.size(); i++) {
+    models[i].path = std::string(projects[i]->path());
+    models[i].target = file_utils::directoryName(paths_.absolute(projects[i]->path()));
+    models[i].isLibrary = types[i] == Library;
+    models[i].includeFiles.assign(files[i].includeFiles.begin(), files[i].includeFiles.end());
+    models[i].sourceFiles.assign(files[i].sourceFiles.begin(), files[i].sourceFiles.end());
+  }
+
+  const auto io = file_utils::BatchIo::create(walkOptions_.io);
+  const ThreadPool pool(0);
+  std::vector<ProjectAnalysis> projectAnalyses(projects.size());
+
+  // test sources are left out of the models, what the targets need is decided without them
+  if (options_.registerTests) {
+    const auto tests = analysis::planTests(models, options_.tests, *io, pool);
+    size_t count = 0;
+    for (size_t i = 0; i < projects.size(); i++) {
+      const auto sources = analysis::testSources(tests[i]);
+      models[i].sourceFiles.erase(std::remove_if(models[i].sourceFiles.begin(), models[i].sourceFiles.end(),
+        [&sources, &models, i](const std::string& file) {
+          return sources.count(file_utils::makeRelative(file, models[i].path)) != 0;
+        }
+      ), models[i].sourceFiles.end());
+      projectAnalyses[i].tests = tests[i];
+      count += tests[i].size();
+    }
+
+    // ctest only finds the tests of directories below one that turned testing on
+    const auto root = std::find_if(models.begin(), models.end(), [](const ProjectModel& model) { return model.path == "."; });
+    for (size_t i = 0; i < projects.size(); i++) {
+      projectAnalyses[i].testing = count != 0 && (root != models.end() ? models[i].path == "." : !tests[i].empty());
+    }
+    ioHandler_.write("Registered " + std::to_string(count) + " test executables");
+  }
+
+  analysis::IncludeScanner scanner(analysis::IncludeCacheFile);
+  const auto report = analysis::inferDependencies(models, scanner, *io, pool);
+  for (const auto& line : report.describe()) {
+    ioHandler_.write(line);
+  }
+
+  for (size_t i = 0; i < projects.size(); i++) {
+    projectAnalyses[i].dependencies = report.projects[i];
+  }
+
+  if (options_.precompileHeaders) {
+    const auto precompiledHeaders = analysis::selectPrecompiledHeaders(
+      models, analysis::systemIncludeDirectories(cxxCompiler()), options_.precompiledHeaders, scanner, *io, pool
+    );
+    size_t targets = 0;
+    for (size_t i = 0; i < projects.size(); i++) {
+      projectAnalyses[i].precompiledHeaders = precompiledHeaders[i];
+      targets += precompiledHeaders[i].empty() ? 0 : 1;
+    }
+    ioHandler_.write("Precompiling headers for " + std::to_string(targets) + " of " + std::to_string(projects.size()) + " projects");
   }
+
+  if (options_.unityBuild) {
+    const auto unityGroups = analysis::planUnityBuilds(models, options_.unity, *io, pool);
+    size_t groups = 0;
+    for (size_t i = 0; i < projects.size(); i++) {
+      projectAnalyses[i].unityGroups = unityGroups[i];
+      groups += unityGroups[i].size();
+    }
+    ioHandler_.write("Grouped sources into " + std::to_string(groups) + " unity builds");
+  }
+
+  if (options_.splitProjects) {
+    const auto parts = analysis::planProjectParts(models, options_.parts, scanner, *io, pool);
+    size_t split = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < projects.size(); i++) {
+      projectAnalyses[i].parts = parts[i];
+      split += parts[i].empty() ? 0 : 1;
+      count += parts[i].size();
+    }
+    ioHandler_.write("Split " + std::to_string(split) + " projects into " + std::to_string(count) + " parts");
+  }
+
+  scanner.save();
+  return projectAnalyses;
 }
 
 void CmakeGenerator::populateCmakeFile(
   const file_utils::Directory* directory,
+  const file_utils::DirectoryFiles& files,
+  ProjectType projectType,
+  const ProjectAnalysis& projectAnalysis,
   const std::string& cmakeVersion,
   const std::string& cppVersion
 ) {
-  auto cmakeFile = std::make_shared<cmake::CmakeFile>(directory->path());
+  auto cmakeFile = std::make_shared<cmake::CmakeFile>(std::string(directory->path()));
 
-  const auto projectName = file_utils::directoryName(directory->path());
+  const auto projectName = file_utils::directoryName(paths_.absolute(directory->path()));
 
   cmakeFile->addFunction(cmake::CmakeFunction::create("cmake_minimum_required", {
     {"VERSION"},
@@ -200,14 +404,18 @@ void CmakeGenerator::populateCmakeFile(
     {"CXX"}
   }));
 
-  const auto subDirectories = getSubDirectoriesForProject(directory);
-  for (const auto* subDirectory : subDirectories) {
+  // only the nearest projects are added, the ones nested below them are added by their own CMakeLists.txt
+  directory->visitDepthFirst([&cmakeFile, directory](const file_utils::Directory& subDirectory) {
+    if (&subDirectory == directory || !subDirectory.hasCmakeFile()) {
+      return file_utils::Directory::Continue;
+    }
+
     cmakeFile->addFunction(cmake::CmakeFunction::create("add_subdirectory", {
-      {file_utils::directoryName(subDirectory->path())}
+      {std::string(file_utils::PathArena::relativeTo(subDirectory.path(), directory->path()))}
     }));
-  }
+    return file_utils::Directory::SkipChildren;
+  });
 
-  auto files = file_utils::getFilesForProject(directory);
   const auto hasIncludeFiles = !files.includeFiles.empty();
   const auto hasSourceFiles = !files.sourceFiles.empty();
   if (hasIncludeFiles || hasSourceFiles) {
@@ -216,12 +424,20 @@ void CmakeGenerator::populateCmakeFile(
     }
 
     if (hasSourceFiles) {
-      cmakeFile->addFunction(files.createSourceFilesFunction(directory));
+      // sources compiled in a part or a test aren't listed for the target itself
+      auto builtElsewhere = analysis::partSources(projectAnalysis.parts);
+      const auto testSources = analysis::testSources(projectAnalysis.tests);
+      builtElsewhere.insert(testSources.begin(), testSources.end());
+      auto targetFiles = files;
+      targetFiles.sourceFiles.erase(std::remove_if(targetFiles.sourceFiles.begin(), targetFiles.sourceFiles.end(),
+        [&builtElsewhere, directory](std::string_view file) {
+          return builtElsewhere.count(file_utils::makeRelative(file, directory->path())) != 0;
+        }
+      ), targetFiles.sourceFiles.end());
+      cmakeFile->addFunction(targetFiles.createSourceFilesFunction(directory));
     }
 
-    ioHandler_.write("Found source files for " + projectName + " what should the project type be? (lib/exe)");
-    const auto projectType = getProjectType(ioHandler_).find("lib") != std::string::npos ? "add_library" : "add_executable";
-    cmakeFile->addFunction(cmake::CmakeFunction::create(projectType,
+    cmakeFile->addFunction(cmake::CmakeFunction::create(projectType == Library ? "add_library" : "add_executable",
       files.availableFileTypeArguments(projectName)
     ));
 
@@ -231,6 +447,35 @@ void CmakeGenerator::populateCmakeFile(
       {cppVersion}
     }));
 
+    const auto scoped = [&projectName](
+      const std::vector<std::string>& publicValues,
+      const std::vector<std::string>& privateValues
+    ) {
+      std::vector<cmake::CmakeFunctionArgument> arguments = {{projectName}};
+      if (!publicValues.empty()) {
+        arguments.push_back({"PUBLIC"});
+        arguments.insert(arguments.end(), publicValues.begin(), publicValues.end());
+      }
+      if (!privateValues.empty()) {
+        arguments.push_back({"PRIVATE"});
+        arguments.insert(arguments.end(), privateValues.begin(), privateValues.end());
+      }
+      return arguments;
+    };
+
+    const auto& dependencies = projectAnalysis.dependencies;
+    if (!dependencies.publicIncludeDirectories.empty() || !dependencies.privateIncludeDirectories.empty()) {
+      cmakeFile->addFunction(cmake::CmakeFunction::create("target_include_directories",
+        scoped(dependencies.publicIncludeDirectories, dependencies.privateIncludeDirectories)
+      ));
+    }
+
+    if (!dependencies.publicLibraries.empty() || !dependencies.privateLibraries.empty()) {
+      cmakeFile->addFunction(cmake::CmakeFunction::create("target_link_libraries",
+        scoped(dependencies.publicLibraries, dependencies.privateLibraries)
+      ));
+    }
+
     cmakeFile->addFunction(cmake::CmakeFunction::create("if", {
       {"CMAKE_CXX_COMPILER_ID MATCHES \"GNU|Clang\""},
     }));
@@ -251,5 +496,32 @@ void CmakeGenerator::populateCmakeFile(
     }));
   }
 
-  cmakeFile->write();
+  auto contents = cmakeFile->render();
+  contents = cmake::replaceManagedSection(contents, analysis::PrecompiledHeadersSection,
+    analysis::renderPrecompiledHeaders(projectName, projectAnalysis.precompiledHeaders)
+  );
+  contents = cmake::replaceManagedSection(contents, analysis::UnityBuildSection,
+    analysis::renderUnityBuild(projectName, projectAnalysis.unityGroups)
+  );
+  contents = cmake::replaceManagedSection(contents, analysis::ProjectPartsSection,
+    analysis::renderProjectParts(projectName, projectAnalysis.parts)
+  );
+  contents = cmake::replaceManagedSection(contents, analysis::TestsSection,
+    analysis::renderTests(projectName, projectType == Library, projectAnalysis.tests)
+  );
+  // a project of subdirectories only has no target to give the profile
+  if (hasIncludeFiles || hasSourceFiles) {
+    contents = cmake::replaceManagedSection(contents, cmake::ReleaseProfileSection,
+      cmake::renderReleaseProfile(projectName, options_.releaseProfile, analysis::testExecutables(projectName, projectAnalysis.tests))
+    );
+  }
+  if (options_.buildTools && directory->path() == ".") {
+    contents = cmake::replaceManagedSection(contents, cmake::BuildToolsSection,
+      cmake::renderBuildTools(cmake::findBuildTools()), "project"
+    );
+  }
+  if (projectAnalysis.testing) {
+    contents = cmake::replaceManagedSection(contents, analysis::TestingSection, cmake::renderFunction("enable_testing", {}), "project");
+  }
+  file_utils::replaceFile(std::string(directory->path()) + "/CMakeLists.txt", contents);
 }
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "../compilationdatabase.h"
+
+#include "../file_utils/batchio.h"
+#include "../file_utils/directory.h"
+
+#include "../iohandler.h"
+#include "../projectmodel.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace {
+  const std::string DatabaseFile = "compile_commands.json";
+  const std::string FileKey = "    \"file\": ";
+
+  std::string quoteJson(const std::string& value) {
+    std::string quoted = "\"";
+    for (const char character : value) {
+      switch (character) {
+        case '"': quoted += "\\\""; break;
+        case '\\': quoted += "\\\\"; break;
+        case '\n': quoted += "\\n"; break;
+        case '\t': quoted += "\\t"; break;
+        default: quoted += character;
+      }
+    }
+    return quoted + "\"";
+  }
+
+  // Entries of a database this class wrote, keyed by their file. Anything else yields no entries.
+  std::map<std::string, std::string> readEntries(const std::string& contents) {
+    std::map<std::string, std::string> entries = {};
+    std::string entry;
+    std::string file;
+    bool inEntry = false;
+    size_t start = 0;
+    while (start < contents.size()) {
+      auto end = contents.find('\n', start);
+      if (end == std::string::npos) {
+        end = contents.size();
+      }
+      const auto line = contents.substr(start, end - start);
+      start = end + 1;
+
+      if (line == "  {") {
+        inEntry = true;
+        entry = line;
+        file.clear();
+      } else if (inEntry && line.compare(0, 3, "  }") == 0) {
+        entries[file] = entry + "\n  }";
+        inEntry = false;
+      } else if (inEntry) {
+        if (line.compare(0, FileKey.size(), FileKey) == 0) {
+          file = line.substr(FileKey.size());
+        }
+        entry += "\n" + line;
+      }
+    }
+    return entries;
+  }
+}
+
+CompilationDatabase::CompilationDatabase(
+  IoHandler& ioHandler,
+  const file_utils::IgnoreFile& ignoreFile,
+  const file_utils::WalkOptions& walkOptions,
+  const std::string& cppVersion,
+  bool verbose
+) : ioHandler_(ioHandler), ignoreFile_(ignoreFile), walkOptions_(walkOptions), cppVersion_(cppVersion), verbose_(verbose),
+  paths_(file_utils::PathArena::forCurrentPath()) {
+}
+
+int CompilationDatabase::run() {
+  file_utils::WalkReport walkReport;
+  const auto directoryRoot = file_utils::getDirectories(ignoreFile_, paths_, walkOptions_, walkReport);
+  for (const auto& line : walkReport.describe()) {
+    ioHandler_.write(line);
+  }
+
+  const auto io = file_utils::BatchIo::create(walkOptions_.io);
+  const auto projects = loadProjectModels(*directoryRoot, paths_, *io, cppVersion_, ioHandler_);
+
+  const auto compiler = cxxCompiler();
+
+  std::map<std::string, std::string> entries = {};
+  for (const auto& project : projects) {
+    for (const auto& sourceFile : project.sourceFiles) {
+      entries[quoteJson(paths_.absolute(sourceFile))] = renderEntry(project, project.target, sourceFile, compiler);
+    }
+    for (const auto* splitTargets : {&project.parts, &project.tests}) {
+      for (const auto& target : *splitTargets) {
+        for (const auto& sourceFile : target.sourceFiles) {
+          entries[quoteJson(paths_.absolute(sourceFile))] = renderEntry(project, target.name, sourceFile, compiler);
+        }
+      }
+    }
+  }
+
+  const auto current = file_utils::SyncBatchIo::readFile(DatabaseFile);
+  const auto currentEntries = current.ok ? readEntries(current.data) : std::map<std::string, std::string>();
+
+  std::vector<std::pair<char, std::string>> changes = {};
+  auto currentEntry = currentEntries.begin();
+  auto entry = entries.begin();
+  while (currentEntry != currentEntries.end() || entry != entries.end()) {
+    if (entry == entries.end() || (currentEntry != currentEntries.end() && currentEntry->first < entry->first)) {
+      changes.push_back({'-', currentEntry->first});
+      ++currentEntry;
+    } else if (currentEntry == currentEntries.end() || entry->first < currentEntry->first) {
+      changes.push_back({'+', entry->first});
+      ++entry;
+    } else {
+      if (currentEntry->second != entry->second) {
+        changes.push_back({'~', entry->first});
+      }
+      ++currentEntry;
+      ++entry;
+    }
+  }
+
+  std::string contents = "[\n";
+  for (const auto& rendered : entries) {
+    contents += rendered.second + (&rendered == &*entries.rbegin() ? "\n" : ",\n");
+  }
+  contents += "]\n";
+
+  if (changes.empty() && current.ok && current.data == contents) {
+    ioHandler_.write(DatabaseFile + " is up to date (" + std::to_string(entries.size()) + " entries)");
+    return 0;
+  }
+
+  if (!file_utils::replaceFile(DatabaseFile, contents)) {
+    ioHandler_.write("Could not write " + DatabaseFile);
+    return 1;
+  }
+
+  const auto count = [&changes](char kind) {
+    return std::to_string(std::count_if(changes.begin(), changes.end(), [kind](const auto& change) {
+      return change.first == kind;
+    }));
+  };
+  ioHandler_.write(
+    "Wrote " + DatabaseFile + " (" + std::to_string(entries.size()) + " entries): " +
+    count('+') + " added, " + count('~') + " changed, " + count('-') + " removed"
+  );
+  if (verbose_) {
+    for (const auto& change : changes) {
+      ioHandler_.write(std::string("  ") + change.first + " " + change.second.substr(1, change.second.size() - 2));
+    }
+  }
+  return 0;
+}
+
+std::string CompilationDatabase::renderEntry(
+  const ProjectModel& project,
+  const std::string& target,
+  const std::string& sourceFile,
+  const std::string& compiler
+) const {
+  const auto projectDirectory = paths_.absolute(project.path);
+  const auto relativeFile = std::string(file_utils::PathArena::relativeTo(sourceFile, project.path));
+  const auto objectFile = "CMakeFiles/" + target + ".dir/" + relativeFile + ".o";
+
+  std::vector<std::string> arguments = {compiler};
+  const auto flags = compileFlags(project, paths_);
+  arguments.insert(arguments.end(), flags.begin(), flags.end());
+  arguments.insert(arguments.end(), {"-o", objectFile, "-c", paths_.absolute(sourceFile)});
+
+  std::string argumentList;
+  for (const auto& argument : arguments) {
+    argumentList += (argumentList.empty() ? "" : ", ") + quoteJson(argument);
+  }
+
+  return
+    "  {\n"
+    "    \"directory\": " + quoteJson(projectDirectory) + ",\n"
+    "    \"arguments\": [" + argumentList + "],\n"
+    "    \"output\": " + quoteJson(objectFile) + ",\n" +
+    FileKey + quoteJson(paths_.absolute(sourceFile)) + "\n"
+    "  }";
+}
@@ -0,0 +1,113 @@
+#include "../generationrules.h"
+#include "../file_utils/fileutils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+
+namespace {
+  // paths are matched without the ./ every walked path starts with
+  std::string_view rootRelative(std::string_view path) {
+    return path.substr(0, 2) == "./" ? path.substr(2) : path;
+  }
+
+  bool isIdentifierCharacter(char c) {
+    return c == '_' || std::isalnum(static_cast<unsigned char>(c));
+  }
+}
+
+bool GenerationRules::load(const std::string& fileName, GenerationRules& rules, std::string& error) {
+  std::ifstream stream(fileName);
+  unsigned int lineNumber = 0;
+  for (std::string line; std::getline(stream, line);) {
+    lineNumber++;
+    const auto start = line.find_first_not_of(" \t");
+    if (start == std::string::npos || line[start] == '#') {
+      continue;
+    }
+
+    const auto keywordEnd = line.find_first_of(" \t", start);
+    const auto patternStart = keywordEnd == std::string::npos ? std::string::npos : line.find_first_not_of(" \t", keywordEnd);
+    if (patternStart == std::string::npos) {
+      error = fileName + ":" + std::to_string(lineNumber) + ": expected a pattern after " + line.substr(start);
+      return false;
+    }
+
+    const auto keyword = line.substr(start, keywordEnd - start);
+    const auto pattern = line.substr(patternStart, line.find_last_not_of(" \t\r") + 1 - patternStart);
+    if (keyword == "project") {
+      rules.addProjects(pattern);
+    } else if (keyword == "exe") {
+      rules.addType(pattern, Executable);
+    } else if (keyword == "lib") {
+      rules.addType(pattern, Library);
+    } else {
+      error = fileName + ":" + std::to_string(lineNumber) + ": unknown rule " + keyword + ", expected project, exe or lib";
+      return false;
+    }
+  }
+  return true;
+}
+
+void GenerationRules::addProjects(const std::string& pattern) {
+  projects_.push_back(pattern);
+}
+
+void GenerationRules::addType(const std::string& pattern, ProjectType type) {
+  types_.push_back({pattern, type});
+}
+
+bool GenerationRules::hasProjects() const {
+  return !projects_.empty();
+}
+
+bool GenerationRules::isProject(std::string_view path) const {
+  const auto relative = rootRelative(path);
+  return std::any_of(projects_.begin(), projects_.end(), [&relative](const std::string& pattern) {
+    return file_utils::matchesGlob(pattern, relative);
+  });
+}
+
+GenerationRules::ProjectType GenerationRules::projectType(std::string_view path) const {
+  const auto relative = rootRelative(path);
+  const auto rule = std::find_if(types_.begin(), types_.end(), [&relative](const auto& type) {
+    return file_utils::matchesGlob(type.first, relative);
+  });
+  return rule != types_.end() ? rule->second : DetectMain;
+}
+
+bool definesMain(std::string_view source) {
+  for (auto position = source.find("main"); position != std::string_view::npos; position = source.find("main", position + 4)) {
+    if (position > 0 && isIdentifierCharacter(source[position - 1])) {
+      continue;
+    }
+
+    auto next = position + 4;
+    while (next < source.size() && std::isspace(static_cast<unsigned char>(source[next]))) {
+      next++;
+    }
+    if (next == source.size() || source[next] != '(') {
+      continue;
+    }
+
+    // the word before it has to be the return type, which rules out calls and declarations like foo.main(
+    auto end = position;
+    while (end > 0 && std::isspace(static_cast<unsigned char>(source[end - 1]))) {
+      end--;
+    }
+    auto begin = end;
+    while (begin > 0 && isIdentifierCharacter(source[begin - 1])) {
+      begin--;
+    }
+    const auto returnType = source.substr(begin, end - begin);
+    if (returnType == "int" || returnType == "auto" || returnType == "void") {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool hasMainSourceName(std::string_view file) {
+  const auto name = file.substr(file.find_last_of('/') + 1);
+  return name.substr(0, name.find('.')) == "main";
+}
@@ -0,0 +1,70 @@
+#include "../jobserver.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define JOBSERVER_HAS_FIFO 1
+#endif
+
+#include <cstdlib>
+#include <string>
+
+JobServer::JobServer(unsigned int jobs, unsigned int clients)
+  : readFd_(-1), writeFd_(-1) {
+#ifdef JOBSERVER_HAS_FIFO
+  const char* temporary = std::getenv("TMPDIR");
+  std::string pattern = std::string(temporary != nullptr && *temporary != '\0' ? temporary : "/tmp") + "/cmakegen-jobserver-XXXXXX";
+  if (::mkdtemp(&pattern[0]) == nullptr) {
+    return;
+  }
+  directory_ = pattern;
+  path_ = directory_ + "/fifo";
+
+  // opened read-write so neither end blocks waiting for the other, and left inheritable for make
+  if (::mkfifo(path_.c_str(), 0600) != 0 || (readFd_ = ::open(path_.c_str(), O_RDWR)) < 0 || (writeFd_ = ::open(path_.c_str(), O_WRONLY)) < 0) {
+    return;
+  }
+
+  const std::string tokens(jobs > clients ? jobs - clients : 0, '+');
+  size_t written = 0;
+  while (written < tokens.size()) {
+    const auto count = ::write(writeFd_, tokens.data() + written, tokens.size() - written);
+    if (count <= 0) {
+      break;
+    }
+    written += static_cast<size_t>(count);
+  }
+#else
+  (void)jobs;
+  (void)clients;
+#endif
+}
+
+JobServer::~JobServer() {
+#ifdef JOBSERVER_HAS_FIFO
+  if (readFd_ >= 0) {
+    ::close(readFd_);
+  }
+  if (writeFd_ >= 0) {
+    ::close(writeFd_);
+  }
+  if (!path_.empty()) {
+    ::unlink(path_.c_str());
+  }
+  if (!directory_.empty()) {
+    ::rmdir(directory_.c_str());
+  }
+#endif
+}
+
+bool JobServer::valid() const {
+  return readFd_ >= 0 && writeFd_ >= 0;
+}
+
+std::string JobServer::makeFlags(bool fifo) const {
+  if (fifo) {
+    return "-j --jobserver-auth=fifo:" + path_;
+  }
+  return "-j --jobserver-auth=" + std::to_string(readFd_) + "," + std::to_string(writeFd_);
+}
@@ -0,0 +1,210 @@
+#include "../ninjafile.h"
+
+#include "../file_utils/patharena.h"
+
+#include "../projectmodel.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+
+namespace {
+  const std::string Rules =
+    "rule cxx\n"
+    "  command = $cxx $flags -MD -MT $out -MF $out.d -c $in -o $out.tmp && "
+    "(cmp -s $out.tmp $out && rm -f $out.tmp || mv -f $out.tmp $out)\n"
+    "  depfile = $out.d\n"
+    "  deps = gcc\n"
+    "  restat = 1\n"
+    "  description = Building CXX object $out\n"
+    "\n"
+    "rule ar\n"
+    "  command = rm -f $out.tmp && ar qc $out.tmp $in && ranlib $out.tmp && "
+    "(cmp -s $out.tmp $out && rm -f $out.tmp || mv -f $out.tmp $out)\n"
+    "  restat = 1\n"
+    "  description = Linking CXX static library $out\n"
+    "\n"
+    "rule link\n"
+    "  command = $cxx -o $out $in $libs\n"
+    "  description = Linking CXX executable $out\n";
+
+  // $, spaces and colons have a meaning of their own in paths of build statements
+  std::string escapePath(const std::string& path) {
+    std::string escaped;
+    for (const char character : path) {
+      if (character == '$' || character == ' ' || character == ':') {
+        escaped += '$';
+      }
+      escaped += character;
+    }
+    return escaped;
+  }
+
+  // Flags end up in a shell command, anything beyond plain characters is quoted.
+  std::string quoteShell(const std::string& value) {
+    const auto plain = value.find_first_not_of(
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-+=/.,:@%"
+    ) == std::string::npos;
+    if (plain && !value.empty()) {
+      return value;
+    }
+
+    std::string quoted = "'";
+    for (const char character : value) {
+      quoted += character == '\'' ? std::string("'\\''") : std::string(1, character);
+    }
+    quoted += "'";
+
+    std::string escaped;
+    for (const char character : quoted) {
+      escaped += character == '$' ? std::string("$$") : std::string(1, character);
+    }
+    return escaped;
+  }
+
+  // Outputs go below the build directory in the same place relative to their project as cmake puts them.
+  std::string outputDirectory(const ProjectModel& project) {
+    return project.path == "." ? std::string() : project.path.substr(2) + "/";
+  }
+
+  std::string archivePath(const ProjectModel& project) {
+    return outputDirectory(project) + "lib" + project.target + ".a";
+  }
+
+  bool hasObjects(const ProjectModel& project) {
+    return !project.sourceFiles.empty() || !project.parts.empty();
+  }
+
+  // what cmake's imported test framework targets link, the library with main() before the one it uses
+  std::string frameworkLibraries(const SplitTarget& test) {
+    const auto links = [&test](const std::string& library) {
+      return std::find(test.linkLibraries.begin(), test.linkLibraries.end(), library) != test.linkLibraries.end();
+    };
+    if (links("GTest::GTest")) {
+      return links("GTest::Main") ? "-lgtest_main -lgtest -pthread" : "-lgtest -pthread";
+    }
+    if (links("Catch2::Catch2WithMain")) {
+      return "-lCatch2Main -lCatch2";
+    }
+    return links("Catch2::Catch2") ? "-lCatch2" : "";
+  }
+}
+
+std::string renderNinjaFile(const std::vector<ProjectModel>& projects, const file_utils::PathArena& paths, const std::string& compiler) {
+  std::map<std::string, const ProjectModel*> libraries = {};
+  for (const auto& project : projects) {
+    if (project.isLibrary && hasObjects(project)) {
+      libraries[project.target] = &project;
+    }
+  }
+
+  // a static library has to come before the libraries it uses on the link line, the order is built backwards
+  const auto linkLine = [&libraries](const ProjectModel& project, std::string& archives) {
+    std::vector<std::string> order = {};
+    std::set<std::string> visited = {};
+    std::function<void(const ProjectModel&)> visit = [&](const ProjectModel& current) {
+      for (auto itr = current.linkLibraries.rbegin(); itr != current.linkLibraries.rend(); ++itr) {
+        const auto& library = *itr;
+        const auto found = libraries.find(library);
+        if (found != libraries.end() && visited.insert(library).second) {
+          visit(*found->second);
+          order.push_back(escapePath(archivePath(*found->second)));
+        } else if (found == libraries.end() && visited.insert(library).second) {
+          if (library == "Threads::Threads") {
+            order.push_back("-pthread");
+          } else if (library[0] == '-' && library.find('$') == std::string::npos) {
+            order.push_back(quoteShell(library));
+          } else if (library.find("::") == std::string::npos && library.find('$') == std::string::npos && library.find('/') == std::string::npos) {
+            order.push_back("-l" + quoteShell(library));
+          }
+        }
+      }
+    };
+    visit(project);
+
+    std::string line;
+    for (auto itr = order.rbegin(); itr != order.rend(); ++itr) {
+      line += (line.empty() ? "" : " ") + *itr;
+      if (itr->compare(0, 1, "-") != 0) {
+        archives += " " + *itr;
+      }
+    }
+    return line;
+  };
+
+  std::string contents =
+    "# Generated by cmakegen -b --system ninja-direct from the CMakeLists.txt files, changes are overwritten.\n"
+    "ninja_required_version = 1.3\n"
+    "cxx = " + quoteShell(compiler) + "\n"
+    "\n" + Rules;
+
+  std::string defaults;
+  for (size_t i = 0; i < projects.size(); i++) {
+    const auto& project = projects[i];
+    if (!hasObjects(project) && project.tests.empty()) {
+      continue;
+    }
+
+    const auto flagsName = "flags_" + std::to_string(i);
+    std::string flags;
+    for (const auto& flag : compileFlags(project, paths)) {
+      flags += " " + quoteShell(flag);
+    }
+    contents += "\n# " + project.target + " in " + project.path + "\n" + flagsName + " =" + flags + "\n";
+
+    // parts and tests are compiled with the flags of the project into object directories of their own
+    const auto compile = [&](const std::string& target, const std::vector<std::string>& sourceFiles) {
+      std::string objects;
+      for (const auto& sourceFile : sourceFiles) {
+        const auto relativeFile = std::string(file_utils::PathArena::relativeTo(sourceFile, project.path));
+        const auto objectFile = escapePath(outputDirectory(project) + "CMakeFiles/" + target + ".dir/" + relativeFile + ".o");
+        contents += "build " + objectFile + ": cxx " + escapePath(paths.absolute(sourceFile)) + "\n  flags = $" + flagsName + "\n";
+        objects += " " + objectFile;
+      }
+      return objects;
+    };
+
+    // the objects of the parts go straight into the target, as cmake links an object library
+    auto objects = compile(project.target, project.sourceFiles);
+    for (const auto& part : project.parts) {
+      objects += compile(part.name, part.sourceFiles);
+    }
+
+    std::string archives;
+    auto libs = linkLine(project, archives);
+    if (project.isLibrary && !objects.empty()) {
+      const auto archive = escapePath(archivePath(project));
+      contents += "build " + archive + ": ar" + objects + "\n";
+      defaults += " " + archive;
+      // tests of a library link it ahead of what it links itself
+      libs = archive + (libs.empty() ? "" : " " + libs);
+      archives = " " + archive + archives;
+    } else if (!objects.empty()) {
+      const auto executable = escapePath(outputDirectory(project) + project.target);
+      contents += "build " + executable + ": link" + objects + (archives.empty() ? "" : " |" + archives) + "\n";
+      if (!libs.empty()) {
+        contents += "  libs = " + libs + "\n";
+      }
+      defaults += " " + executable;
+    }
+
+    // tests are built like cmake builds them but not registered, ninja-direct has no ctest to run them
+    for (const auto& test : project.tests) {
+      const auto testObjects = compile(test.name, test.sourceFiles);
+      const auto executable = escapePath(outputDirectory(project) + test.name);
+      const auto framework = frameworkLibraries(test);
+      const auto testLibs = libs + (libs.empty() || framework.empty() ? "" : " ") + framework;
+      contents += "build " + executable + ": link" + testObjects + (archives.empty() ? "" : " |" + archives) + "\n";
+      if (!testLibs.empty()) {
+        contents += "  libs = " + testLibs + "\n";
+      }
+      defaults += " " + executable;
+    }
+  }
+
+  if (!defaults.empty()) {
+    contents += "\ndefault" + defaults + "\n";
+  }
+  return contents;
+}
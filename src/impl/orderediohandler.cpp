@@ -0,0 +1,57 @@
+#include "../orderediohandler.h"
+
+OrderedIoHandler::OrderedIoHandler(IoHandler& output, size_t taskCount)
+  : output_(output), nextTask_(0) {
+  tasks_.reserve(taskCount);
+  for (size_t i = 0; i < taskCount; i++) {
+    tasks_.push_back({std::make_unique<TaskIoHandler>(*this, i), {}, false});
+  }
+}
+
+IoHandler& OrderedIoHandler::task(size_t index) {
+  return *tasks_[index].handler;
+}
+
+void OrderedIoHandler::finish(size_t index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tasks_[index].finished = true;
+
+  while (nextTask_ < tasks_.size() && tasks_[nextTask_].finished) {
+    nextTask_++;
+    if (nextTask_ == tasks_.size()) {
+      break;
+    }
+
+    auto& next = tasks_[nextTask_];
+    for (const auto& line : next.lines) {
+      output_.write(line);
+    }
+    next.lines.clear();
+  }
+}
+
+void OrderedIoHandler::write(size_t index, const std::string& text) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (index == nextTask_) {
+    output_.write(text);
+  } else {
+    tasks_[index].lines.push_back(text);
+  }
+}
+
+std::string OrderedIoHandler::input() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return output_.input();
+}
+
+OrderedIoHandler::TaskIoHandler::TaskIoHandler(OrderedIoHandler& owner, size_t index)
+  : owner_(owner), index_(index) {
+}
+
+void OrderedIoHandler::TaskIoHandler::write(const std::string& text) {
+  owner_.write(index_, text);
+}
+
+std::string OrderedIoHandler::TaskIoHandler::input() {
+  return owner_.input();
+}
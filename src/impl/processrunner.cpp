@@ -0,0 +1,189 @@
+#include "../processrunner.h"
+#include "../iohandler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <string_view>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define PROCESS_HAS_SPAWN 1
+
+extern char** environ;
+#else
+#include <stdlib.h>
+#endif
+
+namespace {
+  // A heavy translation unit easily takes a gigabyte, starting more jobs than that would only make the machine swap.
+  const unsigned long long MemoryPerJob = 1024ULL * 1024ULL * 1024ULL;
+
+  using Clock = std::chrono::steady_clock;
+
+  double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  // Memory that can be handed out without swapping, page cache included where the system reports it, 0 if unknown.
+  unsigned long long availableMemory() {
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    unsigned long long kilobytes;
+    while (meminfo >> key >> kilobytes) {
+      if (key == "MemAvailable:") {
+        return kilobytes * 1024ULL;
+      }
+      meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+
+#if defined(PROCESS_HAS_SPAWN) && defined(_SC_AVPHYS_PAGES)
+    const long pages = ::sysconf(_SC_AVPHYS_PAGES);
+    const long pageSize = ::sysconf(_SC_PAGESIZE);
+    if (pages > 0 && pageSize > 0) {
+      return static_cast<unsigned long long>(pages) * static_cast<unsigned long long>(pageSize);
+    }
+#endif
+    return 0;
+  }
+
+#ifdef PROCESS_HAS_SPAWN
+  void forwardLines(int fd, IoHandler& output) {
+    std::string pending;
+    char buffer[4096];
+    for (;;) {
+      const auto count = ::read(fd, buffer, sizeof(buffer));
+      if (count < 0 && errno == EINTR) {
+        continue;
+      }
+      if (count <= 0) {
+        break;
+      }
+
+      pending.append(buffer, static_cast<size_t>(count));
+      size_t start = 0;
+      size_t end;
+      while ((end = pending.find('\n', start)) != std::string::npos) {
+        output.write(pending.substr(start, end - start));
+        start = end + 1;
+      }
+      pending.erase(0, start);
+    }
+
+    if (!pending.empty()) {
+      output.write(pending);
+    }
+  }
+#else
+  std::string quote(const std::string& argument) {
+    return "\"" + argument + "\"";
+  }
+#endif
+}
+
+ProcessRunner::ProcessRunner(IoHandler& output)
+  : output_(output) {
+}
+
+ProcessResult ProcessRunner::run(const std::vector<std::string>& arguments, const std::vector<std::string>& environment) {
+  const auto start = Clock::now();
+
+#ifdef PROCESS_HAS_SPAWN
+  // both ends are closed in the child, otherwise a process started at the same time from another
+  // thread keeps the write end open and this output never ends
+  int pipeFds[2];
+#ifdef __linux__
+  const int piped = ::pipe2(pipeFds, O_CLOEXEC);
+#else
+  const int piped = ::pipe(pipeFds);
+  if (piped == 0) {
+    ::fcntl(pipeFds[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(pipeFds[1], F_SETFD, FD_CLOEXEC);
+  }
+#endif
+  if (piped != 0) {
+    output_.write("Could not start " + arguments.front());
+    return {127, millisecondsSince(start)};
+  }
+
+  // stdout and stderr share the pipe so compiler errors stay next to the command that caused them
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDOUT_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDERR_FILENO);
+  posix_spawn_file_actions_addclose(&actions, pipeFds[1]);
+
+  std::vector<char*> argv = {};
+  for (const auto& argument : arguments) {
+    argv.push_back(const_cast<char*>(argument.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  std::vector<char*> envp = {};
+  for (char** variable = environ; *variable != nullptr; variable++) {
+    const std::string_view current(*variable);
+    const auto replaced = std::any_of(environment.begin(), environment.end(), [&current](const std::string& replacement) {
+      const auto name = replacement.substr(0, replacement.find('=') + 1);
+      return current.substr(0, name.size()) == name;
+    });
+    if (!replaced) {
+      envp.push_back(*variable);
+    }
+  }
+  for (const auto& variable : environment) {
+    envp.push_back(const_cast<char*>(variable.c_str()));
+  }
+  envp.push_back(nullptr);
+
+  pid_t pid;
+  const int error = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), envp.data());
+  posix_spawn_file_actions_destroy(&actions);
+  ::close(pipeFds[1]);
+
+  if (error != 0) {
+    ::close(pipeFds[0]);
+    output_.write("Could not start " + arguments.front());
+    return {127, millisecondsSince(start)};
+  }
+
+  forwardLines(pipeFds[0], output_);
+  ::close(pipeFds[0]);
+
+  int status = 0;
+  while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+  }
+
+  const int exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+  return {exitCode, millisecondsSince(start)};
+#else
+  for (const auto& variable : environment) {
+    const auto separator = variable.find('=');
+    _putenv_s(variable.substr(0, separator).c_str(), variable.substr(separator + 1).c_str());
+  }
+
+  std::string command;
+  for (const auto& argument : arguments) {
+    command += (command.empty() ? "" : " ") + quote(argument);
+  }
+  const int exitCode = system(command.c_str());
+  return {exitCode, millisecondsSince(start)};
+#endif
+}
+
+unsigned int ProcessRunner::buildJobs() {
+  const unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+  const auto memory = availableMemory();
+  if (memory == 0) {
+    return cores;
+  }
+
+  const auto memoryJobs = static_cast<unsigned int>(std::max(1ULL, memory / MemoryPerJob));
+  return std::min(cores, memoryJobs);
+}
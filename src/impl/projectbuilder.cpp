@@ -7,121 +7,722 @@
 #include "../cmake/cmakefile.h"
 #include "../cmake/cmakefunctioncriteria.h"
 #include "../cmake/impl/constants.h"
+#include "../cmake/managedsection.h"
+
+#include "../analysis/includescanner.h"
+#include "../analysis/projectparts.h"
+#include "../analysis/testtargets.h"
+
+#include "../buildreport.h"
+#include "../iohandler.h"
+#include "../jobserver.h"
+#include "../ninjafile.h"
+#include "../orderediohandler.h"
+#include "../projectmodel.h"
+#include "../threadpool.h"
+
+#include "../diff/unifieddiff.h"
 
 #include <algorithm>
-#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
 
 namespace {
-  bool isSetArgument(const cmake::CmakeFunctionArgument& argument) {
-    return argument.value_ == cmake::constants::SetIncludeFilesArgumentName || argument.value_ == cmake::constants::SetSourceFilesArgumentName;
+  // The argument as a path relative to the project, without quotes or a leading ./
+  std::string_view argumentPath(const cmake::CmakeFunctionArgument& argument) {
+    std::string_view value = argument.value_;
+    if (argument.quoted_ && value.size() >= 2) {
+      value = value.substr(1, value.size() - 2);
+    }
+    if (value.substr(0, 2) == "./") {
+      value.remove_prefix(2);
+    }
+    return value;
   }
 
-  bool fileMatchesArgument(const cmake::CmakeFunctionArgument& argument, const std::string& filePath) {
-    const auto relativePath = file_utils::makeRelative(filePath);
-    return argument.value_ == relativePath;
-  }
+  // One merge pass over both sorted lists, the first argument is the name of the set and not a file.
+  FileSetDiff diffFiles(
+    const std::vector<std::string_view>& newFiles,
+    const std::vector<cmake::CmakeFunctionArgument>& currentArguments,
+    std::string_view projectPath
+  ) {
+    std::vector<std::string_view> current = {};
+    current.reserve(currentArguments.size());
+    for (size_t i = 1; i < currentArguments.size(); i++) {
+      current.push_back(argumentPath(currentArguments[i]));
+    }
+    std::sort(current.begin(), current.end());
+    current.erase(std::unique(current.begin(), current.end()), current.end());
+
+    // the new files share the project path as prefix, so they stay sorted once it is cut off
+    std::vector<std::string_view> wanted = {};
+    wanted.reserve(newFiles.size());
+    for (const auto& file : newFiles) {
+      wanted.push_back(file_utils::PathArena::relativeTo(file, projectPath));
+    }
 
-  bool filesChanged(const std::vector<std::string>& newFiles, const std::vector<cmake::CmakeFunctionArgument>& currentArguments) {
-    return std::any_of(currentArguments.begin(), currentArguments.end(), [&newFiles](const cmake::CmakeFunctionArgument& argument) {
-      if (isSetArgument(argument.value_)) {
-        return true;
+    FileSetDiff diff;
+    auto currentFile = current.begin();
+    auto wantedFile = wanted.begin();
+    while (currentFile != current.end() || wantedFile != wanted.end()) {
+      if (wantedFile == wanted.end() || (currentFile != current.end() && *currentFile < *wantedFile)) {
+        diff.removed.emplace_back(*currentFile++);
+      } else if (currentFile == current.end() || *wantedFile < *currentFile) {
+        diff.added.emplace_back(*wantedFile++);
+      } else {
+        ++currentFile;
+        ++wantedFile;
       }
+    }
 
-      return std::any_of(newFiles.begin(), newFiles.end(), [&argument](const std::string& newFile) {
-        return !fileMatchesArgument(argument, newFile);
-      });
-    });
+    return diff;
+  }
+
+  void writeDiff(IoHandler& output, const FileSetDiff& diff) {
+    for (const auto& file : diff.added) {
+      output.write("  + ./" + file);
+    }
+    for (const auto& file : diff.removed) {
+      output.write("  - ./" + file);
+    }
+  }
+
+  using Clock = std::chrono::steady_clock;
+
+  const std::string BuildDirectory = "_build";
+  const std::string DirectBuildDirectory = BuildDirectory + "/direct";
+  const size_t ReportedEdges = 10;
+
+  std::vector<std::string> sanitizerArguments(const std::string& flags) {
+    return {
+      "-DCMAKE_BUILD_TYPE=Debug",
+      "-DCMAKE_CXX_FLAGS=" + flags + " -fno-omit-frame-pointer",
+      "-DCMAKE_EXE_LINKER_FLAGS=" + flags,
+      "-DCMAKE_SHARED_LINKER_FLAGS=" + flags
+    };
+  }
+
+  const std::vector<BuildConfiguration> Configurations = {
+    {"debug", BuildDirectory + "/debug", {"-DCMAKE_BUILD_TYPE=Debug"}},
+    {"release", BuildDirectory + "/release", {"-DCMAKE_BUILD_TYPE=Release"}},
+    {"relwithdebinfo", BuildDirectory + "/relwithdebinfo", {"-DCMAKE_BUILD_TYPE=RelWithDebInfo"}},
+    {"minsizerel", BuildDirectory + "/minsizerel", {"-DCMAKE_BUILD_TYPE=MinSizeRel"}},
+    {"asan", BuildDirectory + "/asan", sanitizerArguments("-fsanitize=address")},
+    {"ubsan", BuildDirectory + "/ubsan", sanitizerArguments("-fsanitize=undefined")},
+    {"tsan", BuildDirectory + "/tsan", sanitizerArguments("-fsanitize=thread")}
+  };
+
+  // Lines of one of several builds running at the same time, marked with the build they belong to.
+  class PrefixIoHandler : public IoHandler {
+  public:
+    PrefixIoHandler(IoHandler& output, std::mutex& mutex, const std::string& prefix)
+      : output_(output), mutex_(mutex), prefix_(prefix) {
+    }
+
+    void write(const std::string& text) override {
+      std::lock_guard<std::mutex> lock(mutex_);
+      output_.write(prefix_ + text);
+    }
+
+    std::string input() override {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return output_.input();
+    }
+
+  private:
+    IoHandler& output_;
+    std::mutex& mutex_;
+    std::string prefix_;
+  };
+
+  std::string formatDuration(double milliseconds) {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1) << milliseconds << " ms";
+    return text.str();
+  }
+
+  std::string elapsed(Clock::time_point start) {
+    return formatDuration(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+  }
+
+  std::string cmakeFilePath(const file_utils::Directory& directory) {
+    return std::string(directory.path()) + "/" + cmake::constants::FileName;
+  }
+
+  // The library or executable the project defines, empty when there is none.
+  std::string projectTarget(const cmake::CmakeFile& cmakeFile) {
+    const auto* projectFunction = cmakeFile.getFunction(cmake::CmakeProjectFunctionCriteria());
+    if (projectFunction == nullptr || projectFunction->arguments().empty()) {
+      return "";
+    }
+    const auto* outputFunction = cmakeFile.getFunction(cmake::CmakeOutputFunctionCriteria(projectFunction->arguments()[0].value_));
+    return outputFunction != nullptr && !outputFunction->arguments().empty() ? outputFunction->arguments()[0].value_ : "";
   }
 }
 
-ProjectBuilder::ProjectBuilder(const std::string& buildSystem, const file_utils::IgnoreFile& ignoreFile, IoHandler& ioHandler)
-  : buildSystem_(buildSystem), ignoreFile_(ignoreFile), ioHandler_(ioHandler) {
+bool FileSetDiff::empty() const {
+  return added.empty() && removed.empty();
 }
 
-void ProjectBuilder::run() {
-  update();
+ProjectBuilder::ProjectBuilder(
+  const ProjectBuilderOptions& options,
+  const file_utils::IgnoreFile& ignoreFile,
+  const file_utils::WalkOptions& walkOptions,
+  IoHandler& ioHandler
+) : options_(options), ignoreFile_(ignoreFile), walkOptions_(walkOptions), ioHandler_(ioHandler), paths_(file_utils::PathArena::forCurrentPath()),
+  io_(file_utils::BatchIo::create(walkOptions.io)) {
+}
+
+int ProjectBuilder::run() {
+  const bool cmakeFilesChanged = update();
 
-  build();
+  if (options_.dryRun) {
+    return 0;
+  }
+  return build(cmakeFilesChanged);
 }
 
-void ProjectBuilder::update() {
-  auto directoryRoot = file_utils::getDirectories(ignoreFile_);
+// Returns true when any CMakeLists.txt was written.
+bool ProjectBuilder::update() {
+  file_utils::WalkReport walkReport;
+  std::vector<std::string> timings = {};
+  auto phaseStart = Clock::now();
+  std::atomic<bool> changed(false);
+  const auto buildTools = options_.buildTools ? cmake::findBuildTools() : cmake::BuildTools();
 
-  const auto cmakeDirectories = directoryRoot->filter([](const file_utils::Directory& directory){
-    return directory.hasCmakeFile();
-  });
+  if (options_.stream) {
+    ProjectSections sections;
+    sections.releaseProfile = options_.releaseProfile ? &options_.profile : nullptr;
+    sections.buildTools = options_.buildTools ? &buildTools : nullptr;
+    file_utils::walkProjects(ignoreFile_, paths_, walkOptions_, walkReport, [this, &sections, &changed](const file_utils::Directory& cmakeDirectory) {
+      const auto contents = io_->readFiles({cmakeFilePath(cmakeDirectory)});
+      if (updateProject(cmakeDirectory, contents.front(), sections, ioHandler_)) {
+        changed = true;
+      }
+    });
+    timings.push_back("walk and update " + elapsed(phaseStart));
+    if (options_.precompileHeaders) {
+      ioHandler_.write("--pch looks at the whole tree at once and is skipped with --stream");
+    }
+    if (options_.unityBuild) {
+      ioHandler_.write("--unity looks at the whole tree at once and is skipped with --stream");
+    }
+    if (options_.splitProjects) {
+      ioHandler_.write("--split looks at the whole tree at once and is skipped with --stream");
+    }
+    if (options_.registerTests) {
+      ioHandler_.write("--tests looks at the whole tree at once and is skipped with --stream");
+    }
+  } else {
+    auto directoryRoot = file_utils::getDirectories(ignoreFile_, paths_, walkOptions_, walkReport);
+    timings.push_back("walk " + elapsed(phaseStart));
+    phaseStart = Clock::now();
 
-  for (const auto* cmakeDirectory : cmakeDirectories) {
-    const auto cmakeFile = cmake::CmakeFile::parse(
-      cmakeDirectory->path(),
-      cmakeDirectory->path() + "/" + cmake::constants::FileName,
-      ioHandler_
-    );
-    auto projectFiles = file_utils::getFilesForProject(cmakeDirectory);
+    // every CMakeLists.txt is read in one batch before any of them is parsed
+    std::vector<const file_utils::Directory*> cmakeDirectories = {};
+    std::vector<std::string> cmakeFilePaths = {};
+    for (const auto& directory : directoryRoot->depthFirst()) {
+      if (directory.hasCmakeFile()) {
+        cmakeDirectories.push_back(&directory);
+        cmakeFilePaths.push_back(cmakeFilePath(directory));
+      }
+    }
+    const auto contents = io_->readFiles(cmakeFilePaths);
+    timings.push_back("read " + elapsed(phaseStart));
+    phaseStart = Clock::now();
+
+    const ThreadPool pool(options_.jobs);
+    std::vector<ProjectSections> sections(cmakeDirectories.size());
+    for (auto& section : sections) {
+      section.releaseProfile = options_.releaseProfile ? &options_.profile : nullptr;
+      section.buildTools = options_.buildTools ? &buildTools : nullptr;
+    }
+    std::vector<std::vector<analysis::PrecompiledHeader>> precompiledHeaders = {};
+    std::vector<std::vector<analysis::UnityGroup>> unityGroups = {};
+    std::vector<std::vector<analysis::ProjectPart>> parts = {};
+    std::vector<std::vector<analysis::TestTarget>> tests = {};
+    bool testing = false;
+    std::vector<ProjectModel> projects = {};
+    if (options_.precompileHeaders || options_.unityBuild || options_.splitProjects || options_.registerTests) {
+      projects.resize(cmakeDirectories.size());
+      for (size_t i = 0; i < cmakeDirectories.size(); i++) {
+        const auto files = file_utils::getFilesForProject(cmakeDirectories[i]);
+        projects[i].path = std::string(cmakeDirectories[i]->path());
+        projects[i].includeFiles.assign(files.includeFiles.begin(), files.includeFiles.end());
+        projects[i].sourceFiles.assign(files.sourceFiles.begin(), files.sourceFiles.end());
+      }
+    }
 
-    if (projectFiles.empty()) {
-      continue;
+    // test sources are left out of the models, the other sections are planned without them; without
+    // --tests they are the ones of the tests section an earlier run wrote
+    if (options_.registerTests) {
+      tests = analysis::planTests(projects, options_.tests, *io_, pool);
+    }
+    for (size_t i = 0; i < projects.size(); i++) {
+      const auto sources = options_.registerTests ? analysis::testSources(tests[i])
+        : contents[i].ok ? analysis::parseTestSources(contents[i].data) : std::unordered_set<std::string>();
+      // without --tests the new test sources next to a tests section are left out as well, updateProject reports them
+      const bool unplannedTests = !options_.registerTests && !sources.empty();
+      projects[i].sourceFiles.erase(std::remove_if(projects[i].sourceFiles.begin(), projects[i].sourceFiles.end(),
+        [this, &sources, &projects, i, unplannedTests](const std::string& file) {
+          return sources.count(file_utils::makeRelative(file, projects[i].path)) != 0
+            || (unplannedTests && analysis::isTestSource(options_.tests, file));
+        }
+      ), projects[i].sourceFiles.end());
+    }
+    if (options_.registerTests) {
+      const bool hasRoot = std::any_of(projects.begin(), projects.end(), [](const ProjectModel& project) { return project.path == "."; });
+      for (size_t i = 0; i < cmakeDirectories.size(); i++) {
+        testing = testing || !tests[i].empty();
+        sections[i].tests = &tests[i];
+        // ctest only finds the tests of directories below one that turned testing on
+        if (hasRoot ? projects[i].path == "." : !tests[i].empty()) {
+          sections[i].testing = &testing;
+        }
+      }
+      timings.push_back("tests " + elapsed(phaseStart));
+      phaseStart = Clock::now();
     }
 
-    const auto* includeFileFunction = cmakeFile->getFunction(
-      cmake::CmakeSetFileFunctionCriteria(cmake::CmakeSetFileFunctionCriteria::IncludeFiles)
-    );
-    if (!projectFiles.includeFiles.empty()) {
-      replaceSetFunction([&cmakeFile](const std::vector<std::string>& files) {
-        cmakeFile->replaceIncludeFiles(files);
-      }, includeFileFunction, projectFiles.includeFiles);
-    } else if (includeFileFunction) {
-      cmakeFile->removeIncludeFiles();
+    if (options_.precompileHeaders || options_.splitProjects) {
+      // one scanner for both, so the cache it saves covers every file either of them scanned
+      analysis::IncludeScanner scanner(analysis::IncludeCacheFile);
+      const auto scanned = [&scanner]() {
+        const auto failed = scanner.failedCount();
+        return std::to_string(scanner.readCount()) + " files scanned" + (failed > 0 ? ", " + std::to_string(failed) + " unreadable" : "");
+      };
+      if (options_.precompileHeaders) {
+        precompiledHeaders = analysis::selectPrecompiledHeaders(
+          projects, analysis::systemIncludeDirectories(cxxCompiler()), options_.precompiledHeaders, scanner, *io_, pool
+        );
+        for (size_t i = 0; i < cmakeDirectories.size(); i++) {
+          sections[i].precompiledHeaders = &precompiledHeaders[i];
+        }
+        timings.push_back("precompiled headers " + elapsed(phaseStart) + " (" + scanned() + ")");
+        phaseStart = Clock::now();
+      }
+
+      if (options_.splitProjects) {
+        parts = analysis::planProjectParts(projects, options_.parts, scanner, *io_, pool);
+        for (size_t i = 0; i < cmakeDirectories.size(); i++) {
+          sections[i].parts = &parts[i];
+        }
+        timings.push_back("parts " + elapsed(phaseStart) + " (" + scanned() + ")");
+        phaseStart = Clock::now();
+      }
+      if (!options_.dryRun) {
+        scanner.save();
+      }
+    }
+
+    if (options_.unityBuild) {
+      unityGroups = analysis::planUnityBuilds(projects, options_.unity, *io_, pool);
+      for (size_t i = 0; i < cmakeDirectories.size(); i++) {
+        sections[i].unityGroups = &unityGroups[i];
+      }
+      timings.push_back("unity groups " + elapsed(phaseStart));
+      phaseStart = Clock::now();
+    }
+
+    // projects are independent of each other, only their output has to be put back in order
+    OrderedIoHandler output(ioHandler_, cmakeDirectories.size());
+    pool.forEach(cmakeDirectories.size(), [this, &cmakeDirectories, &contents, &sections, &output, &changed](size_t i) {
+      if (updateProject(*cmakeDirectories[i], contents[i], sections[i], output.task(i))) {
+        changed = true;
+      }
+      output.finish(i);
+    });
+    timings.push_back("update " + elapsed(phaseStart) + " (" + std::to_string(cmakeDirectories.size()) + " projects)");
+  }
+
+  for (const auto& line : walkReport.describe()) {
+    ioHandler_.write(line);
+  }
+
+  if (options_.dryRun || options_.verbose) {
+    std::string line = "Timings:";
+    for (const auto& timing : timings) {
+      line += (line.back() == ':' ? " " : ", ") + timing;
+    }
+    ioHandler_.write(line);
+  }
+
+  return changed;
+}
+
+// Returns true when the file was written.
+bool ProjectBuilder::updateProject(
+  const file_utils::Directory& cmakeDirectory,
+  const file_utils::FileContents& contents,
+  const ProjectSections& sections,
+  IoHandler& output
+) {
+  if (!contents.ok) {
+    output.write("Could not read " + cmakeFilePath(cmakeDirectory));
+    return false;
+  }
+
+  const auto directoryPath = std::string(cmakeDirectory.path());
+  const auto cmakeFile = cmake::CmakeFile::parseContents(directoryPath, contents.data, output);
+  auto projectFiles = file_utils::getFilesForProject(&cmakeDirectory);
+
+  // the top level CMakeLists.txt often only adds the projects, it is still visited for its build tools and testing sections
+  const bool buildTools = sections.buildTools != nullptr && directoryPath == ".";
+  if (projectFiles.empty() && !buildTools && sections.testing == nullptr) {
+    return false;
+  }
+
+  FileSetDiff includeDiff;
+  const auto* includeFileFunction = cmakeFile->getFunction(
+    cmake::CmakeSetFileFunctionCriteria(cmake::CmakeSetFileFunctionCriteria::IncludeFiles)
+  );
+  if (!projectFiles.includeFiles.empty()) {
+    includeDiff = replaceSetFunction([&cmakeFile](const std::vector<std::string_view>& files) {
+      cmakeFile->replaceIncludeFiles(files);
+    }, includeFileFunction, projectFiles.includeFiles, cmakeDirectory.path());
+  } else if (includeFileFunction && !projectFiles.empty()) {
+    includeDiff = diffFiles({}, includeFileFunction->arguments(), cmakeDirectory.path());
+    cmakeFile->removeIncludeFiles();
+  }
+
+  // sources compiled in a part aren't listed for the target itself, the parts written before lose the sources that are gone
+  const auto target = projectTarget(*cmakeFile);
+  std::vector<analysis::ProjectPart> keptParts = {};
+  const auto* parts = sections.parts;
+  if (parts == nullptr && !target.empty()) {
+    std::unordered_set<std::string> sources = {};
+    for (const auto& file : projectFiles.sourceFiles) {
+      sources.insert(file_utils::makeRelative(file, cmakeDirectory.path()));
     }
+    for (auto& part : analysis::parseProjectParts(contents.data, target)) {
+      part.sources.erase(std::remove_if(part.sources.begin(), part.sources.end(), [&sources](const std::string& source) {
+        return sources.count(source) == 0;
+      }), part.sources.end());
+      if (!part.sources.empty()) {
+        keptParts.push_back(std::move(part));
+      }
+    }
+    parts = &keptParts;
+  }
+  // as are the sources of tests, the tests written before are kept as they are
+  auto builtElsewhere = sections.tests != nullptr ? analysis::testSources(*sections.tests) : analysis::parseTestSources(contents.data);
+  if (parts != nullptr) {
+    const auto partSources = analysis::partSources(*parts);
+    builtElsewhere.insert(partSources.begin(), partSources.end());
+  }
+  // a test source the tests section doesn't know yet isn't built into the target either, only --tests adds it
+  const bool unplannedTests = sections.tests == nullptr && !analysis::parseTestSources(contents.data).empty();
+  if (!builtElsewhere.empty()) {
+    projectFiles.sourceFiles.erase(std::remove_if(projectFiles.sourceFiles.begin(), projectFiles.sourceFiles.end(),
+      [this, &builtElsewhere, &cmakeDirectory, &output, unplannedTests](std::string_view file) {
+        if (builtElsewhere.count(file_utils::makeRelative(file, cmakeDirectory.path())) != 0) {
+          return true;
+        }
+        if (unplannedTests && analysis::isTestSource(options_.tests, file)) {
+          output.write(std::string(file) + " looks like a test, left out of the target until -b --tests adds it");
+          return true;
+        }
+        return false;
+      }
+    ), projectFiles.sourceFiles.end());
+  }
 
-    const auto* sourceFileFunction = cmakeFile->getFunction(
-      cmake::CmakeSetFileFunctionCriteria(cmake::CmakeSetFileFunctionCriteria::SourceFiles)
+  FileSetDiff sourceDiff;
+  const auto* sourceFileFunction = cmakeFile->getFunction(
+    cmake::CmakeSetFileFunctionCriteria(cmake::CmakeSetFileFunctionCriteria::SourceFiles)
+  );
+  if (!projectFiles.sourceFiles.empty()) {
+    sourceDiff = replaceSetFunction([&cmakeFile](const std::vector<std::string_view>& files) {
+      cmakeFile->replaceSourceFiles(files);
+    }, sourceFileFunction, projectFiles.sourceFiles, cmakeDirectory.path());
+  }
+
+  const bool filesChanged = !includeDiff.empty() || !sourceDiff.empty();
+  auto updated = filesChanged ? cmakeFile->render() : contents.data;
+  if (parts != nullptr && !target.empty()) {
+    updated = cmake::replaceManagedSection(updated, analysis::ProjectPartsSection, analysis::renderProjectParts(target, *parts));
+  }
+  if (sections.precompiledHeaders != nullptr && !target.empty()) {
+    updated = cmake::replaceManagedSection(updated, analysis::PrecompiledHeadersSection,
+      analysis::renderPrecompiledHeaders(target, *sections.precompiledHeaders)
+    );
+  }
+  if (sections.unityGroups != nullptr && !target.empty()) {
+    updated = cmake::replaceManagedSection(updated, analysis::UnityBuildSection,
+      analysis::renderUnityBuild(target, *sections.unityGroups)
     );
-    if (!projectFiles.sourceFiles.empty()) {
-      replaceSetFunction([&cmakeFile](const std::vector<std::string>& files) {
-        cmakeFile->replaceSourceFiles(files);
-      }, sourceFileFunction, projectFiles.sourceFiles);
+  }
+  if (sections.tests != nullptr && !target.empty()) {
+    const auto* outputFunction = cmakeFile->getFunction(cmake::CmakeOutputFunctionCriteria(target));
+    const bool library = outputFunction == nullptr || outputFunction->name() == "add_library";
+    updated = cmake::replaceManagedSection(updated, analysis::TestsSection, analysis::renderTests(target, library, *sections.tests));
+  }
+  // the profile's PGO link flags follow the tests, a profile written before is kept when only the tests changed
+  cmake::ReleaseProfile writtenProfile;
+  const auto* releaseProfile = sections.releaseProfile != nullptr ? sections.releaseProfile
+    : sections.tests != nullptr && cmake::readReleaseProfile(contents.data, writtenProfile) ? &writtenProfile : nullptr;
+  if (releaseProfile != nullptr && !target.empty()) {
+    const auto executables = sections.tests != nullptr ? analysis::testExecutables(target, *sections.tests)
+      : analysis::parseTestExecutables(contents.data);
+    updated = cmake::replaceManagedSection(updated, cmake::ReleaseProfileSection,
+      cmake::renderReleaseProfile(target, *releaseProfile, executables)
+    );
+  }
+  if (buildTools) {
+    updated = cmake::replaceManagedSection(updated, cmake::BuildToolsSection, cmake::renderBuildTools(*sections.buildTools), "project");
+  }
+  if (sections.testing != nullptr) {
+    updated = cmake::replaceManagedSection(updated, analysis::TestingSection,
+      *sections.testing ? cmake::renderFunction("enable_testing", {}) : "", "project"
+    );
+  }
+
+  if (updated == contents.data) {
+    return false;
+  }
+
+  if (options_.verbose) {
+    output.write("Updated " + cmakeFilePath(cmakeDirectory));
+    writeDiff(output, includeDiff);
+    writeDiff(output, sourceDiff);
+    if (sections.precompiledHeaders != nullptr && !target.empty()) {
+      for (const auto& header : *sections.precompiledHeaders) {
+        output.write("  pch " + header.header + " (" + std::to_string(header.translationUnits) + " sources, " + std::to_string(header.size) + " bytes)");
+      }
+    }
+    if (sections.parts != nullptr && !target.empty()) {
+      for (const auto& part : *sections.parts) {
+        output.write("  part " + part.name + " (" + std::to_string(part.sources.size()) + " sources, " + std::to_string(part.bytes) + " bytes)");
+      }
+    }
+    if (sections.tests != nullptr && !target.empty()) {
+      for (const auto& test : *sections.tests) {
+        output.write("  test " + target + "_" + test.name + " (" + std::to_string(test.sources.size()) + " sources)");
+      }
     }
+    if (sections.unityGroups != nullptr && !target.empty()) {
+      for (const auto& group : *sections.unityGroups) {
+        output.write("  unity " + group.name + " (" + std::to_string(group.sources.size()) + " sources, " + std::to_string(group.bytes) + " bytes)");
+      }
+    }
+  }
 
-    cmakeFile->write();
+  const auto path = cmakeFilePath(cmakeDirectory);
+  if (options_.dryRun) {
+    auto fileDiff = diff::unifiedDiff(contents.data, updated, path, path);
+    if (!fileDiff.empty()) {
+      fileDiff.pop_back();
+      output.write(fileDiff);
+    }
+    return false;
   }
+
+  file_utils::replaceFile(path, updated);
+  return true;
 }
 
-void ProjectBuilder::replaceSetFunction(
-  const std::function<void(const std::vector<std::string>&)> replaceFileFunction,
+FileSetDiff ProjectBuilder::replaceSetFunction(
+  const std::function<void(const std::vector<std::string_view>&)> replaceFileFunction,
   const cmake::CmakeFunction* function,
-  const std::vector<std::string>& files
+  const std::vector<std::string_view>& files,
+  std::string_view projectPath
 ) {
   if (!function) {
     replaceFileFunction(files);
-    return;
+    return diffFiles(files, {}, projectPath);
   }
 
-  const auto& arguments = function->arguments();
-  const bool differentSize = files.size() != arguments.size() - 1;
-  if (differentSize) {
+  auto diff = diffFiles(files, function->arguments(), projectPath);
+  if (!diff.empty()) {
     replaceFileFunction(files);
-    return;
   }
 
-  const auto differentFiles = filesChanged(files, arguments);
-  if (differentFiles) {
-    replaceFileFunction(files);
+  return diff;
+}
+
+int ProjectBuilder::build(bool cmakeFilesChanged) {
+  const bool direct = options_.buildSystem == "ninja-direct";
+  const bool ninja = direct || options_.buildSystem == "ninja";
+  const auto jobs = options_.jobs ? options_.jobs : ProcessRunner::buildJobs();
+  const std::vector<std::string> jobArguments = {"-j", std::to_string(jobs)};
+
+  if (direct) {
+    if (!options_.configurations.empty()) {
+      ioHandler_.write("ninja-direct builds a single configuration, --configs needs cmake");
+    }
+    const int written = writeDirectNinjaFile();
+    if (written != 0) {
+      return written;
+    }
+    return buildConfiguration({"", DirectBuildDirectory, {}}, true, false, jobArguments, {}, jobs, ioHandler_).exitCode;
+  }
+
+  if (options_.configurations.empty()) {
+    return buildConfiguration({"", BuildDirectory, {}}, ninja, cmakeFilesChanged, jobArguments, {}, jobs, ioHandler_).exitCode;
+  }
+
+  std::vector<BuildConfiguration> configurations = {};
+  for (const auto& name : options_.configurations) {
+    const auto found = std::find_if(Configurations.begin(), Configurations.end(), [&name](const BuildConfiguration& configuration) {
+      return configuration.name == name;
+    });
+    if (found == Configurations.end()) {
+      ioHandler_.write("Unknown configuration " + name + ", expected debug, release, relwithdebinfo, minsizerel, asan, ubsan or tsan");
+      return 1;
+    }
+    configurations.push_back(*found);
   }
+  return buildConfigurations(configurations, ninja, cmakeFilesChanged, jobs);
 }
 
-void ProjectBuilder::build() {
-  file_utils::createDir("_build");
+// The configurations build at the same time and take their jobs from one jobserver, so together they
+// never run more than the budget while one that is linking leaves its jobs to the others. Every client
+// runs one job without a token, so no more configurations build at once than there are jobs, the
+// others wait for one of them to finish.
+int ProjectBuilder::buildConfigurations(const std::vector<BuildConfiguration>& configurations, bool ninja, bool cmakeFilesChanged, unsigned int jobs) {
+  const auto start = Clock::now();
+  const auto concurrent = std::min(jobs, static_cast<unsigned int>(configurations.size()));
+  JobServer jobServer(jobs, concurrent);
 
-  // TODO: Handle more build systems here
-  int result;
-  if (buildSystem_ == "ninja") {
-    result = system("cd _build && cmake -GNinja ../ && ninja");
+  // without a jobserver the budget is split evenly, with one the clients must not be given their own -j
+  std::vector<std::string> jobArguments = {};
+  std::vector<std::string> environment = {};
+  if (jobServer.valid()) {
+    environment.push_back("MAKEFLAGS=" + jobServer.makeFlags(ninja));
   } else {
-    result = system("cd _build && cmake ../ && make");
+    const auto share = std::max(1u, jobs / concurrent);
+    jobArguments = {"-j", std::to_string(share)};
+  }
+
+  std::mutex outputMutex;
+  std::vector<ProcessResult> results(configurations.size());
+  ThreadPool(concurrent).forEach(configurations.size(), [&](size_t i) {
+    PrefixIoHandler output(ioHandler_, outputMutex, "[" + configurations[i].name + "] ");
+    results[i] = buildConfiguration(configurations[i], ninja, cmakeFilesChanged, jobArguments, environment, jobs, output);
+  });
+
+  double sequential = 0;
+  int exitCode = 0;
+  for (size_t i = 0; i < configurations.size(); i++) {
+    ioHandler_.write(configurations[i].name + ": " + formatDuration(results[i].milliseconds) + (results[i].exitCode == 0 ? "" : " (failed)"));
+    sequential += results[i].milliseconds;
+    if (exitCode == 0) {
+      exitCode = results[i].exitCode;
+    }
+  }
+  ioHandler_.write(
+    "Built " + std::to_string(configurations.size()) + " configurations in " + elapsed(start) + ", " + formatDuration(sequential) +
+    " one after another, sharing " + std::to_string(jobs) + " jobs" + (jobServer.valid() ? "" : " split evenly")
+  );
+  return exitCode;
+}
+
+// Configures when needed and builds one directory, the result has the time of both steps.
+ProcessResult ProjectBuilder::buildConfiguration(
+  const BuildConfiguration& configuration,
+  bool ninja,
+  bool cmakeFilesChanged,
+  const std::vector<std::string>& jobArguments,
+  const std::vector<std::string>& environment,
+  unsigned int jobs,
+  IoHandler& output
+) {
+  const auto start = Clock::now();
+  const auto total = [&start]() {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  };
+
+  ProcessRunner runner(output);
+  if (configuration.directory != DirectBuildDirectory) {
+    const int configured = configure(runner, configuration, ninja, cmakeFilesChanged, output);
+    if (configured != 0) {
+      return {configured, total()};
+    }
+  }
+
+  std::vector<std::string> arguments = {ninja ? "ninja" : "make", "-C", configuration.directory};
+  arguments.insert(arguments.end(), jobArguments.begin(), jobArguments.end());
+
+  const auto ninjaLogFile = configuration.directory + "/.ninja_log";
+  const auto logBefore = file_utils::SyncBatchIo::statFile(ninjaLogFile);
+  const auto built = runner.run(arguments, environment);
+  output.write("Built in " + formatDuration(built.milliseconds) + (jobArguments.empty() ? " (jobserver)" : " (-j " + jobArguments.back() + ")"));
+  if (built.exitCode != 0) {
+    output.write("Build failed with exit code " + std::to_string(built.exitCode));
+  }
+
+  if (options_.buildReport && !ninja) {
+    output.write("The build report is read from .ninja_log, use --system ninja or ninja-direct to get one");
+  } else if (options_.buildReport) {
+    for (const auto& line : BuildReport::readNinjaLog(ninjaLogFile, logBefore).describe(ReportedEdges, jobs)) {
+      output.write(line);
+    }
+  }
+  return {built.exitCode, total()};
+}
+
+int ProjectBuilder::configure(ProcessRunner& runner, const BuildConfiguration& configuration, bool ninja, bool cmakeFilesChanged, IoHandler& output) {
+  // a configured build directory reruns cmake by itself when a CMakeLists.txt changed behind our back
+  if (!cmakeFilesChanged && isConfigured(configuration.directory, ninja)) {
+    output.write("No CMakeLists.txt changed, skipping configure");
+    return 0;
+  }
+
+  std::vector<std::string> arguments = {"cmake", "-S", ".", "-B", configuration.directory};
+  if (ninja) {
+    arguments.push_back("-GNinja");
+  }
+  arguments.insert(arguments.end(), configuration.cmakeArguments.begin(), configuration.cmakeArguments.end());
+  const auto configured = runner.run(arguments);
+  output.write("Configured in " + formatDuration(configured.milliseconds));
+  if (configured.exitCode != 0) {
+    output.write("Configure failed with exit code " + std::to_string(configured.exitCode));
   }
+  return configured.exitCode;
+}
+
+// Renders build.ninja from the CMakeLists.txt files as they are after the update, the file is only
+// replaced when it changed so ninja doesn't have to reload it.
+int ProjectBuilder::writeDirectNinjaFile() {
+  const auto start = Clock::now();
+  file_utils::WalkReport walkReport;
+  const auto directoryRoot = file_utils::getDirectories(ignoreFile_, paths_, walkOptions_, walkReport);
+  const auto projects = loadProjectModels(*directoryRoot, paths_, *io_, options_.cppVersion, ioHandler_);
+  const auto contents = renderNinjaFile(projects, paths_, cxxCompiler());
+
+  const auto ninjaFile = DirectBuildDirectory + "/build.ninja";
+  const auto current = file_utils::SyncBatchIo::readFile(ninjaFile);
+  if (current.ok && current.data == contents) {
+    ioHandler_.write(ninjaFile + " is up to date (" + elapsed(start) + ")");
+    return 0;
+  }
+
+  if (!file_utils::replaceFile(ninjaFile, contents)) {
+    ioHandler_.write("Could not write " + ninjaFile);
+    return 1;
+  }
+  ioHandler_.write("Wrote " + ninjaFile + " in " + elapsed(start));
+  return 0;
+}
 
-  if (result != 0) {
-    // TODO: log something here
+// The build directory was generated for the selected build system. cmake writes the cache before it
+// generates, so a configure that failed leaves a cache without the build file next to it.
+bool ProjectBuilder::isConfigured(const std::string& directory, bool ninja) const {
+  if (!std::ifstream(directory + (ninja ? "/build.ninja" : "/Makefile"))) {
+    return false;
+  }
+
+  std::ifstream cache(directory + "/CMakeCache.txt");
+  const std::string expected = std::string("CMAKE_GENERATOR:INTERNAL=") + (ninja ? "Ninja" : "Unix Makefiles");
+  std::string line;
+  while (std::getline(cache, line)) {
+    if (line == expected) {
+      return true;
+    }
   }
+  return false;
 }
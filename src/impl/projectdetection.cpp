@@ -0,0 +1,171 @@
+#include "../projectdetection.h"
+#include "../file_utils/directory.h"
+#include "../generationrules.h"
+#include "../threadpool.h"
+
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <unordered_map>
+
+namespace {
+  using file_utils::Directory;
+
+  // sources are read this many at a time, which bounds the memory the prefixes take
+  const size_t ReadBatch = 1024;
+
+  enum Layout { Sources = 1, Includes = 2, Tests = 4 };
+
+  Layout layoutOf(std::string_view name) {
+    static const std::set<std::string_view> SourceNames = {"src", "source", "sources"};
+    static const std::set<std::string_view> IncludeNames = {"include", "inc"};
+    static const std::set<std::string_view> TestNames = {"test", "tests"};
+    if (SourceNames.count(name) != 0) {
+      return Sources;
+    }
+    if (IncludeNames.count(name) != 0) {
+      return Includes;
+    }
+    return TestNames.count(name) != 0 ? Tests : static_cast<Layout>(0);
+  }
+
+  std::string_view directoryName(const Directory& directory) {
+    const auto path = directory.path();
+    return path.substr(path.find_last_of('/') + 1);
+  }
+
+  // src and include, src and test or include and test next to each other
+  bool hasProjectLayout(const Directory& directory) {
+    int layouts = 0;
+    for (const auto& child : directory.children()) {
+      layouts |= layoutOf(directoryName(*child));
+    }
+    return layouts != 0 && (layouts & (layouts - 1)) != 0;
+  }
+
+  struct Contents {
+    bool sources;
+    bool includes;
+  };
+
+  // a header only tree starts where it branches or where its headers sit below a directory of the
+  // project's name, as in json/json/json.hpp
+  bool isHeaderTreeTop(const Directory& directory, const std::unordered_map<const Directory*, Contents>& contents) {
+    const Directory* headers = nullptr;
+    for (const auto& child : directory.children()) {
+      if (contents.at(child.get()).includes) {
+        if (headers != nullptr) {
+          return true;
+        }
+        headers = child.get();
+      }
+    }
+    return headers != nullptr && directoryName(*headers) == directoryName(directory);
+  }
+
+  // sources below a test directory of the project don't make it an executable
+  bool isTestSource(std::string_view file, std::string_view projectPath) {
+    auto path = file.substr(std::min(file.size(), projectPath.size()));
+    for (auto start = path.find('/'); start != std::string_view::npos; start = path.find('/', start + 1)) {
+      const auto end = path.find('/', start + 1);
+      if (end != std::string_view::npos && layoutOf(path.substr(start + 1, end - start - 1)) == Tests) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  Contents summarize(const Directory& directory, std::unordered_map<const Directory*, Contents>& contents) {
+    Contents summary = {!directory.sourceFiles().empty(), !directory.includeFiles().empty()};
+    for (const auto& child : directory.children()) {
+      const auto childSummary = summarize(*child, contents);
+      summary.sources = summary.sources || childSummary.sources;
+      summary.includes = summary.includes || childSummary.includes;
+    }
+    contents[&directory] = summary;
+    return summary;
+  }
+}
+
+std::vector<const Directory*> proposeProjects(const Directory& root) {
+  std::unordered_map<const Directory*, Contents> contents = {};
+  summarize(root, contents);
+
+  // the root's project takes its src, include and test directories along, its other directories are looked at on their own
+  std::set<const Directory*> rootLayout = {};
+  if (hasProjectLayout(root)) {
+    for (const auto& child : root.children()) {
+      if (layoutOf(directoryName(*child)) != 0) {
+        rootLayout.insert(child.get());
+      }
+    }
+  }
+
+  std::vector<const Directory*> projects = {&root};
+  root.visitDepthFirst([&](const Directory& directory) {
+    if (&directory == &root) {
+      return Directory::Continue;
+    }
+
+    const auto& summary = contents.at(&directory);
+    if ((!summary.sources && !summary.includes) || rootLayout.count(&directory) != 0) {
+      return Directory::SkipChildren;
+    }
+
+    const bool ownFiles = !directory.sourceFiles().empty() || !directory.includeFiles().empty();
+    if (ownFiles || hasProjectLayout(directory) || (!summary.sources && isHeaderTreeTop(directory, contents))) {
+      projects.push_back(&directory);
+      return Directory::SkipChildren;
+    }
+    return Directory::Continue;
+  });
+  return projects;
+}
+
+std::vector<char> detectExecutables(
+  const std::vector<const Directory*>& projects,
+  const std::vector<file_utils::DirectoryFiles>& files,
+  const ProjectDetectionOptions& options,
+  file_utils::BatchIo& io,
+  const ThreadPool& pool
+) {
+  std::vector<char> executables(files.size(), 0);
+  std::vector<std::pair<size_t, std::string_view>> sources = {};
+  for (size_t i = 0; i < files.size(); i++) {
+    std::vector<std::string_view> projectSources = {};
+    std::copy_if(files[i].sourceFiles.begin(), files[i].sourceFiles.end(), std::back_inserter(projectSources),
+      [&projects, i](std::string_view file) { return !isTestSource(file, projects[i]->path()); }
+    );
+    if (std::any_of(projectSources.begin(), projectSources.end(), hasMainSourceName)) {
+      executables[i] = 1;
+      continue;
+    }
+    for (const auto& sourceFile : projectSources) {
+      sources.emplace_back(i, sourceFile);
+    }
+  }
+
+  for (size_t start = 0; start < sources.size(); start += ReadBatch) {
+    // projects already found to define main() aren't read any further
+    std::vector<std::string> paths = {};
+    std::vector<size_t> owners = {};
+    for (size_t i = start; i < std::min(sources.size(), start + ReadBatch); i++) {
+      if (!executables[sources[i].first]) {
+        paths.emplace_back(sources[i].second);
+        owners.push_back(sources[i].first);
+      }
+    }
+
+    const auto prefixes = io.readPrefixes(paths, options.prefixBytes);
+    std::vector<char> hasMain(paths.size(), 0);
+    pool.forEach(paths.size(), [&prefixes, &hasMain](size_t i) {
+      hasMain[i] = prefixes[i].ok && definesMain(prefixes[i].data);
+    });
+    for (size_t i = 0; i < paths.size(); i++) {
+      if (hasMain[i]) {
+        executables[owners[i]] = 1;
+      }
+    }
+  }
+  return executables;
+}
@@ -0,0 +1,323 @@
+#include "../projectmodel.h"
+
+#include "../file_utils/directory.h"
+#include "../file_utils/fileutils.h"
+#include "../file_utils/patharena.h"
+
+#include "../cmake/cmakefile.h"
+#include "../cmake/impl/constants.h"
+
+#include "../analysis/projectparts.h"
+#include "../analysis/testtargets.h"
+
+#include "../orderediohandler.h"
+#include "../threadpool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <set>
+
+namespace {
+  const std::string ProjectNameVariable = "${PROJECT_NAME}";
+
+  std::string unquote(const cmake::CmakeFunctionArgument& argument) {
+    const auto& value = argument.value_;
+    if (argument.quoted_ && value.size() >= 2) {
+      return value.substr(1, value.size() - 2);
+    }
+    return value;
+  }
+
+  // cxx_std_17 is passed to the compiler as -std=c++17
+  std::string standardFlag(const std::string& standard) {
+    const std::string prefix = "cxx_std_";
+    if (standard.compare(0, prefix.size(), prefix) != 0) {
+      return {};
+    }
+    return "-std=c++" + standard.substr(prefix.size());
+  }
+
+  std::string includeDirectory(const std::string& directory, const std::string& projectDirectory) {
+    const std::string currentSourceDirectory = "${CMAKE_CURRENT_SOURCE_DIR}";
+    std::string resolved = directory;
+    if (resolved.compare(0, currentSourceDirectory.size(), currentSourceDirectory) == 0) {
+      resolved = projectDirectory + resolved.substr(currentSourceDirectory.size());
+    } else if (resolved.empty() || resolved[0] != '/') {
+      resolved = projectDirectory + "/" + resolved;
+    }
+    return resolved.find('$') == std::string::npos ? resolved : std::string();
+  }
+
+  struct TargetValue {
+    std::string value;
+    bool self;
+    bool dependents;
+  };
+
+  // The values of a target_*() call on the model's target and who they apply to, PRIVATE when no keyword is given.
+  std::vector<TargetValue> targetValues(const cmake::CmakeFunction& function, const std::string& target, const std::string& projectName) {
+    const auto& arguments = function.arguments();
+    if (arguments.empty()) {
+      return {};
+    }
+
+    auto name = unquote(arguments[0]);
+    if (name == ProjectNameVariable) {
+      name = projectName;
+    }
+    if (name != target) {
+      return {};
+    }
+
+    std::vector<TargetValue> values = {};
+    bool self = true;
+    bool dependents = false;
+    for (size_t i = 1; i < arguments.size(); i++) {
+      auto value = unquote(arguments[i]);
+      if (value == "PUBLIC" || value == "PRIVATE" || value == "INTERFACE") {
+        self = value != "INTERFACE";
+        dependents = value != "PRIVATE";
+      } else if (value != "BEFORE" && value != "AFTER" && value != "SYSTEM") {
+        values.push_back({std::move(value), self, dependents});
+      }
+    }
+    return values;
+  }
+
+  void applyCmakeFile(ProjectModel& model, const cmake::CmakeFile& cmakeFile, const std::string& directoryName, const std::string& defaultStandard) {
+    std::string projectName = directoryName;
+    for (const auto* function : cmakeFile.functions()) {
+      if (function->name() == "project" && !function->arguments().empty()) {
+        projectName = unquote(function->arguments()[0]);
+        break;
+      }
+    }
+
+    model.target = projectName;
+    for (const auto* function : cmakeFile.functions()) {
+      if ((function->name() == "add_executable" || function->name() == "add_library") && !function->arguments().empty()) {
+        model.target = unquote(function->arguments()[0]);
+        if (model.target == ProjectNameVariable) {
+          model.target = projectName;
+        }
+        model.isLibrary = function->name() == "add_library";
+        break;
+      }
+    }
+
+    model.standard = defaultStandard;
+    for (const auto* function : cmakeFile.functions()) {
+      const auto& name = function->name();
+      if (name == "target_compile_features") {
+        for (const auto& value : targetValues(*function, model.target, projectName)) {
+          if (value.self && value.value.compare(0, 8, "cxx_std_") == 0) {
+            model.standard = value.value;
+          }
+        }
+      } else if (name == "target_compile_options") {
+        for (const auto& value : targetValues(*function, model.target, projectName)) {
+          if (value.self) {
+            model.compileOptions.push_back(value.value);
+          }
+        }
+      } else if (name == "target_compile_definitions") {
+        for (const auto& value : targetValues(*function, model.target, projectName)) {
+          const auto definition = value.value.compare(0, 2, "-D") == 0 ? value.value.substr(2) : value.value;
+          if (value.self) {
+            model.definitions.push_back(definition);
+          }
+          if (value.dependents) {
+            model.interfaceDefinitions.push_back(definition);
+          }
+        }
+      } else if (name == "target_include_directories") {
+        for (const auto& value : targetValues(*function, model.target, projectName)) {
+          if (value.self) {
+            model.includeDirectories.push_back(value.value);
+          }
+          if (value.dependents) {
+            model.interfaceIncludeDirectories.push_back(value.value);
+          }
+        }
+      } else if (name == "target_link_libraries") {
+        for (const auto& value : targetValues(*function, model.target, projectName)) {
+          model.linkLibraries.push_back(value.value);
+        }
+      }
+    }
+  }
+
+  // The parts and tests written before take their sources out of the target's, sources that are gone are dropped.
+  void splitTargets(ProjectModel& model, std::string_view contents) {
+    const std::set<std::string> walked(model.sourceFiles.begin(), model.sourceFiles.end());
+    std::set<std::string> split = {};
+    const auto addSources = [&](SplitTarget& target, const std::vector<std::string>& sources) {
+      for (const auto& source : sources) {
+        const auto path = model.path == "." ? source : model.path + source.substr(source.compare(0, 1, ".") == 0 ? 1 : 0);
+        if (walked.count(path) != 0) {
+          split.insert(path);
+          target.sourceFiles.push_back(path);
+        }
+      }
+    };
+
+    for (const auto& part : analysis::parseProjectParts(contents, model.target)) {
+      SplitTarget target = {model.target + "_" + part.name, {}, {}};
+      addSources(target, part.sources);
+      if (!target.sourceFiles.empty()) {
+        model.parts.push_back(std::move(target));
+      }
+    }
+
+    for (const auto& test : analysis::parseTests(contents, model.target)) {
+      SplitTarget target = {model.target + "_" + test.name, {}, {}};
+      addSources(target, test.sources);
+      if (test.framework == analysis::TestFramework::GoogleTest) {
+        target.linkLibraries.push_back("GTest::GTest");
+        if (!test.definesMain) {
+          target.linkLibraries.push_back("GTest::Main");
+        }
+      } else if (test.framework == analysis::TestFramework::Catch2) {
+        target.linkLibraries.push_back(test.definesMain ? "Catch2::Catch2" : "Catch2::Catch2WithMain");
+      }
+      if (!target.sourceFiles.empty()) {
+        model.tests.push_back(std::move(target));
+      }
+    }
+
+    model.sourceFiles.erase(std::remove_if(model.sourceFiles.begin(), model.sourceFiles.end(), [&split](const std::string& file) {
+      return split.count(file) != 0;
+    }), model.sourceFiles.end());
+  }
+}
+
+std::vector<ProjectModel> loadProjectModels(
+  const file_utils::Directory& root,
+  const file_utils::PathArena& paths,
+  file_utils::BatchIo& io,
+  const std::string& defaultStandard,
+  IoHandler& output
+) {
+  std::vector<const file_utils::Directory*> cmakeDirectories = {};
+  std::vector<std::string> cmakeFilePaths = {};
+  for (const auto& directory : root.depthFirst()) {
+    if (directory.hasCmakeFile()) {
+      cmakeDirectories.push_back(&directory);
+      cmakeFilePaths.push_back(std::string(directory.path()) + "/" + cmake::constants::FileName);
+    }
+  }
+  const auto contents = io.readFiles(cmakeFilePaths);
+
+  std::vector<ProjectModel> models(cmakeDirectories.size());
+  OrderedIoHandler orderedOutput(output, cmakeDirectories.size());
+  ThreadPool(0).forEach(cmakeDirectories.size(), [&](size_t i) {
+    const auto& directory = *cmakeDirectories[i];
+    auto& model = models[i];
+    model.path = std::string(directory.path());
+
+    const auto files = file_utils::getFilesForProject(&directory);
+    model.includeFiles.assign(files.includeFiles.begin(), files.includeFiles.end());
+    model.sourceFiles.assign(files.sourceFiles.begin(), files.sourceFiles.end());
+
+    const auto directoryName = file_utils::directoryName(paths.absolute(directory.path()));
+    if (contents[i].ok) {
+      const auto cmakeFile = cmake::CmakeFile::parseContents(model.path, contents[i].data, orderedOutput.task(i));
+      applyCmakeFile(model, *cmakeFile, directoryName, defaultStandard);
+      splitTargets(model, contents[i].data);
+    } else {
+      orderedOutput.task(i).write("Could not read " + cmakeFilePaths[i]);
+      model.target = directoryName;
+      model.standard = defaultStandard;
+    }
+    orderedOutput.finish(i);
+  });
+
+  // interface include directories are made absolute before they reach projects in other directories
+  for (auto& model : models) {
+    const auto projectDirectory = paths.absolute(model.path);
+    for (auto& directory : model.interfaceIncludeDirectories) {
+      directory = includeDirectory(directory, projectDirectory);
+    }
+  }
+
+  std::map<std::string, const ProjectModel*> libraries = {};
+  for (const auto& model : models) {
+    if (model.isLibrary) {
+      libraries[model.target] = &model;
+    }
+  }
+
+  // usage requirements travel along target_link_libraries, libraries linked by libraries included
+  std::vector<std::vector<std::string>> linkedDefinitions(models.size());
+  std::vector<std::vector<std::string>> linkedIncludeDirectories(models.size());
+  for (size_t i = 0; i < models.size(); i++) {
+    std::set<std::string> visited = {models[i].target};
+    std::vector<const ProjectModel*> pending = {&models[i]};
+    while (!pending.empty()) {
+      const auto* current = pending.back();
+      pending.pop_back();
+      for (const auto& library : current->linkLibraries) {
+        const auto found = libraries.find(library);
+        if (found == libraries.end() || !visited.insert(library).second) {
+          continue;
+        }
+
+        const auto& linked = *found->second;
+        linkedDefinitions[i].insert(linkedDefinitions[i].end(), linked.interfaceDefinitions.begin(), linked.interfaceDefinitions.end());
+        linkedIncludeDirectories[i].insert(
+          linkedIncludeDirectories[i].end(),
+          linked.interfaceIncludeDirectories.begin(),
+          linked.interfaceIncludeDirectories.end()
+        );
+        pending.push_back(&linked);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < models.size(); i++) {
+    auto& model = models[i];
+    for (const auto& definition : linkedDefinitions[i]) {
+      if (std::find(model.definitions.begin(), model.definitions.end(), definition) == model.definitions.end()) {
+        model.definitions.push_back(definition);
+      }
+    }
+    for (const auto& directory : linkedIncludeDirectories[i]) {
+      if (!directory.empty() && std::find(model.includeDirectories.begin(), model.includeDirectories.end(), directory) == model.includeDirectories.end()) {
+        model.includeDirectories.push_back(directory);
+      }
+    }
+  }
+
+  return models;
+}
+
+std::vector<std::string> compileFlags(const ProjectModel& project, const file_utils::PathArena& paths) {
+  const auto projectDirectory = paths.absolute(project.path);
+
+  std::vector<std::string> flags = {};
+  for (const auto& definition : project.definitions) {
+    flags.push_back("-D" + definition);
+  }
+  for (const auto& directory : project.includeDirectories) {
+    const auto resolved = includeDirectory(directory, projectDirectory);
+    if (!resolved.empty()) {
+      flags.push_back("-I" + resolved);
+    }
+  }
+  const auto standard = standardFlag(project.standard);
+  if (!standard.empty()) {
+    flags.push_back(standard);
+  }
+  for (const auto& option : project.compileOptions) {
+    if (option.find('$') == std::string::npos) {
+      flags.push_back(option);
+    }
+  }
+  return flags;
+}
+
+std::string cxxCompiler() {
+  const char* compiler = std::getenv("CXX");
+  return compiler != nullptr && *compiler != '\0' ? compiler : "c++";
+}
@@ -0,0 +1,27 @@
+#ifndef JOBSERVER_H
+#define JOBSERVER_H
+#include <string>
+
+// Shares one budget of parallel jobs between several make or ninja processes through the GNU make
+// jobserver protocol: a FIFO holding a token for every job beyond the one each client always has.
+class JobServer {
+public:
+  JobServer(unsigned int jobs, unsigned int clients);
+  ~JobServer();
+  JobServer(const JobServer&) = delete;
+  JobServer& operator=(const JobServer&) = delete;
+
+  // False when the FIFO couldn't be created, the clients then have to be given their own -j.
+  bool valid() const;
+
+  // MAKEFLAGS for a client. make before 4.4 only understands inherited descriptors, ninja only the FIFO path.
+  std::string makeFlags(bool fifo) const;
+
+private:
+  std::string directory_;
+  std::string path_;
+  int readFd_;
+  int writeFd_;
+};
+
+#endif
@@ -1,7 +1,12 @@
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
 #include "cmdoptionparser.h"
 #include "cmakegenerator.h"
+#include "compilationdatabase.h"
+#include "file_utils/fileutils.h"
 #include "file_utils/ignorefile.h"
+#include "generationrules.h"
 #include "iohandler.h"
 #include "cmake/cmakefile.h"
 #include "projectbuilder.h"
@@ -19,16 +24,159 @@ public:
   }
 };
 
-void generateCmakeFiles(const std::string& cmakeVersion, const std::string& cppVersion, const file_utils::IgnoreFile& ignoreFile) {
+file_utils::WalkOptions parseWalkOptions(CmdOptionParser& optionParser) {
+  file_utils::WalkOptions options;
+
+  const auto* cmdSource = optionParser.getOption("--source");
+  if (cmdSource != nullptr && std::string(cmdSource) == "git") {
+    options.source = file_utils::WalkOptions::GitIndex;
+  }
+  options.includeUntracked = optionParser.hasOption("--untracked");
+  options.saveCaches = !optionParser.hasOption("--dry-run");
+
+  const auto* cmdSymlinks = optionParser.getOption("--symlinks");
+  if (cmdSymlinks != nullptr && std::string(cmdSymlinks) == "skip") {
+    options.symlinks = file_utils::WalkOptions::SkipSymlinks;
+  } else if (cmdSymlinks != nullptr && std::string(cmdSymlinks) == "follow") {
+    options.symlinks = file_utils::WalkOptions::FollowSymlinks;
+  }
+
+  const auto* cmdIo = optionParser.getOption("--io");
+  if (cmdIo != nullptr && std::string(cmdIo) == "sync") {
+    options.io = file_utils::BatchIo::Sync;
+  } else if (cmdIo != nullptr && std::string(cmdIo) == "uring") {
+    options.io = file_utils::BatchIo::Uring;
+  }
+
+  return options;
+}
+
+std::vector<std::string> splitList(const char* list) {
+  std::vector<std::string> items = {};
+  std::stringstream stream(list != nullptr ? list : "");
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+// --pch-max and --pch-threshold fine tune --pch, which both -g and -b understand.
+analysis::PrecompiledHeaderOptions parsePrecompiledHeaderOptions(CmdOptionParser& optionParser) {
+  analysis::PrecompiledHeaderOptions options;
+  const auto* cmdMaxHeaders = optionParser.getOption("--pch-max");
+  if (cmdMaxHeaders != nullptr) {
+    options.maxHeaders = static_cast<unsigned int>(std::strtoul(cmdMaxHeaders, nullptr, 10));
+  }
+  const auto* cmdThreshold = optionParser.getOption("--pch-threshold");
+  if (cmdThreshold != nullptr) {
+    options.minimumPercent = static_cast<unsigned int>(std::strtoul(cmdThreshold, nullptr, 10));
+  }
+  return options;
+}
+
+// --unity-bytes sets how many source bytes --unity puts into one unity file.
+analysis::UnityBuildOptions parseUnityBuildOptions(CmdOptionParser& optionParser) {
+  analysis::UnityBuildOptions options;
+  const auto* cmdBatchBytes = optionParser.getOption("--unity-bytes");
+  if (cmdBatchBytes != nullptr) {
+    options.batchBytes = std::strtoull(cmdBatchBytes, nullptr, 10);
+  }
+  return options;
+}
+
+// --split-bytes sets how many source bytes --split puts into one part.
+analysis::ProjectPartOptions parseProjectPartOptions(CmdOptionParser& optionParser) {
+  analysis::ProjectPartOptions options;
+  const auto* cmdPartBytes = optionParser.getOption("--split-bytes");
+  if (cmdPartBytes != nullptr) {
+    options.partBytes = std::strtoull(cmdPartBytes, nullptr, 10);
+  }
+  return options;
+}
+
+// --test-patterns replaces the globs telling test sources apart, --test-lock GLOB=NAME and
+// --test-processors GLOB=N set the properties of the tests of the sources matching GLOB.
+analysis::TestOptions parseTestOptions(CmdOptionParser& optionParser) {
+  analysis::TestOptions options;
+  const auto patterns = splitList(optionParser.getOption("--test-patterns"));
+  if (!patterns.empty()) {
+    options.patterns = patterns;
+  }
+  for (const auto& lock : splitList(optionParser.getOption("--test-lock"))) {
+    const auto separator = lock.find_last_of('=');
+    if (separator != std::string::npos) {
+      options.resourceLocks.push_back({lock.substr(0, separator), lock.substr(separator + 1)});
+    }
+  }
+  for (const auto& processors : splitList(optionParser.getOption("--test-processors"))) {
+    const auto separator = processors.find_last_of('=');
+    if (separator != std::string::npos) {
+      const auto count = std::strtoul(processors.c_str() + separator + 1, nullptr, 10);
+      options.processors.push_back({processors.substr(0, separator), static_cast<unsigned int>(count)});
+    }
+  }
+  return options;
+}
+
+// --profile and --march, which both -g and -b understand. Returns false for an unknown profile.
+bool parseReleaseProfile(CmdOptionParser& optionParser, cmake::ReleaseProfile& profile) {
+  const auto* cmdProfile = optionParser.getOption("--profile");
+  if (cmdProfile != nullptr && !cmake::parseReleaseProfile(cmdProfile, profile)) {
+    std::cout << "unknown profile " << cmdProfile << ", use release or default\n";
+    return false;
+  }
+  const auto* cmdArchitecture = optionParser.getOption("--march");
+  if (cmdArchitecture != nullptr) {
+    profile.architecture = cmdArchitecture;
+  }
+  return true;
+}
+
+int generateCmakeFilesBatch(
+  CmdOptionParser& optionParser,
+  const CmakeGeneratorOptions& options,
+  const file_utils::IgnoreFile& ignoreFile,
+  const file_utils::WalkOptions& walkOptions
+) {
   auto ioHandler = StdIoHandler();
-  CmakeGenerator generator(ioHandler, ignoreFile, cmakeVersion, cppVersion);
+  GenerationRules rules;
+  const auto* cmdRules = optionParser.getOption("--rules");
+  std::string error;
+  if (!GenerationRules::load(cmdRules != nullptr ? cmdRules : ".cmakegenrules", rules, error)) {
+    ioHandler.write(error);
+    return 1;
+  }
+  for (const auto& pattern : splitList(optionParser.getOption("--projects"))) {
+    rules.addProjects(pattern);
+  }
+  for (const auto& pattern : splitList(optionParser.getOption("--exe"))) {
+    rules.addType(pattern, GenerationRules::Executable);
+  }
+  for (const auto& pattern : splitList(optionParser.getOption("--lib"))) {
+    rules.addType(pattern, GenerationRules::Library);
+  }
+
+  CmakeGenerator generator(ioHandler, ignoreFile, walkOptions, options);
+  return generator.runBatch(rules);
+}
+
+void generateCmakeFiles(
+  const CmakeGeneratorOptions& options,
+  const file_utils::IgnoreFile& ignoreFile,
+  const file_utils::WalkOptions& walkOptions
+) {
+  auto ioHandler = StdIoHandler();
+  CmakeGenerator generator(ioHandler, ignoreFile, walkOptions, options);
   generator.run();
 }
 
-void updateCmakeFiles(const std::string& buildSystem, const file_utils::IgnoreFile& ignoreFile) {
+int updateCmakeFiles(const ProjectBuilderOptions& options, const file_utils::IgnoreFile& ignoreFile, const file_utils::WalkOptions& walkOptions) {
   auto ioHandler = StdIoHandler();
-  ProjectBuilder builder(buildSystem, ignoreFile, ioHandler);
-  builder.run();
+  ProjectBuilder builder(options, ignoreFile, walkOptions, ioHandler);
+  return builder.run();
 }
 
 int main(int argc, char *argv[]) {
@@ -39,22 +187,81 @@ int main(int argc, char *argv[]) {
 
   const auto ignoreFile = file_utils::IgnoreFile::load(".cmakeignore");
   CmdOptionParser optionParser(argc, argv);
+  const auto walkOptions = parseWalkOptions(optionParser);
 
   if (optionParser.hasAnyOption({ "-g", "--gen" })) {
+    CmakeGeneratorOptions options;
     const auto* cmdCmakeVersion = optionParser.getOption("--cmake");
+    if (cmdCmakeVersion != nullptr) {
+      options.cmakeVersion = cmdCmakeVersion;
+    }
     const auto* cmdCppVersion = optionParser.getOption("--cpp");
+    if (cmdCppVersion != nullptr) {
+      options.cppVersion = cmdCppVersion;
+    }
+    options.precompileHeaders = optionParser.hasOption("--pch");
+    options.precompiledHeaders = parsePrecompiledHeaderOptions(optionParser);
+    options.unityBuild = optionParser.hasOption("--unity");
+    options.unity = parseUnityBuildOptions(optionParser);
+    options.splitProjects = optionParser.hasOption("--split");
+    options.parts = parseProjectPartOptions(optionParser);
+    options.registerTests = optionParser.hasOption("--tests");
+    options.tests = parseTestOptions(optionParser);
+    if (!parseReleaseProfile(optionParser, options.releaseProfile)) {
+      return 1;
+    }
+    options.buildTools = !optionParser.hasOption("--no-tools");
 
-    generateCmakeFiles(
-      cmdCmakeVersion != nullptr ? cmdCmakeVersion : "3.10.0",
-      cmdCppVersion != nullptr ? cmdCppVersion : "cxx_std_11",
-      ignoreFile
-    );
+    if (optionParser.hasAnyOption({ "--batch", "--rules", "--projects", "--exe", "--lib" })) {
+      return generateCmakeFilesBatch(optionParser, options, ignoreFile, walkOptions);
+    }
+
+    generateCmakeFiles(options, ignoreFile, walkOptions);
   } else if (optionParser.hasAnyOption({ "-b", "--build" })) {
+    ProjectBuilderOptions options;
     const auto* cmdBuildSystem = optionParser.getOption("--system");
-    updateCmakeFiles(
-      cmdBuildSystem != nullptr ? cmdBuildSystem : "make",
-      ignoreFile
+    if (cmdBuildSystem != nullptr) {
+      options.buildSystem = cmdBuildSystem;
+    }
+    options.stream = optionParser.hasOption("--stream");
+    options.verbose = optionParser.hasAnyOption({ "-v", "--verbose" });
+    options.dryRun = optionParser.hasOption("--dry-run");
+    options.buildReport = optionParser.hasOption("--build-report");
+    const auto* cmdCppVersion = optionParser.getOption("--cpp");
+    if (cmdCppVersion != nullptr) {
+      options.cppVersion = cmdCppVersion;
+    }
+    options.configurations = splitList(optionParser.getOption("--configs"));
+    options.precompileHeaders = optionParser.hasOption("--pch");
+    options.precompiledHeaders = parsePrecompiledHeaderOptions(optionParser);
+    options.unityBuild = optionParser.hasOption("--unity");
+    options.unity = parseUnityBuildOptions(optionParser);
+    options.splitProjects = optionParser.hasOption("--split");
+    options.parts = parseProjectPartOptions(optionParser);
+    options.registerTests = optionParser.hasOption("--tests");
+    options.tests = parseTestOptions(optionParser);
+    options.releaseProfile = optionParser.hasAnyOption({ "--profile", "--march" });
+    if (!parseReleaseProfile(optionParser, options.profile)) {
+      return 1;
+    }
+    options.buildTools = optionParser.hasOption("--tools");
+    const auto* cmdJobs = optionParser.getOption("--jobs");
+    if (cmdJobs != nullptr) {
+      options.jobs = static_cast<unsigned int>(std::strtoul(cmdJobs, nullptr, 10));
+    }
+
+    return updateCmakeFiles(options, ignoreFile, walkOptions);
+  } else if (optionParser.hasOption("--compile-commands")) {
+    const auto* cmdCppVersion = optionParser.getOption("--cpp");
+    auto ioHandler = StdIoHandler();
+    CompilationDatabase database(
+      ioHandler,
+      ignoreFile,
+      walkOptions,
+      cmdCppVersion != nullptr ? cmdCppVersion : "cxx_std_11",
+      optionParser.hasAnyOption({ "-v", "--verbose" })
     );
+    return database.run();
   } else {
   }
   return 0;
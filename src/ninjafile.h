@@ -0,0 +1,19 @@
+#ifndef NINJAFILE_H
+#define NINJAFILE_H
+#include <string>
+#include <vector>
+
+namespace file_utils {
+class PathArena;
+}
+
+struct ProjectModel;
+
+// build.ninja that compiles and links the projects with the compiler directly, for builds that don't
+// need cmake in between. Objects are placed like cmake places them, so build reports read the same.
+// Compiles and archives go through a temporary file and restat, an object that comes out the same
+// as before doesn't relink anything that depends on it. Parts are compiled into their target and
+// tests into executables of their own, which ninja-direct builds but doesn't register with ctest.
+std::string renderNinjaFile(const std::vector<ProjectModel>& projects, const file_utils::PathArena& paths, const std::string& compiler);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef ORDEREDIOHANDLER_H
+#define ORDEREDIOHANDLER_H
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "iohandler.h"
+
+// Serializes the output of tasks running on several threads. The first unfinished task writes straight
+// through while the others are buffered until every task before them is done, so the output reads the same
+// as a sequential run.
+class OrderedIoHandler {
+public:
+  OrderedIoHandler(IoHandler& output, size_t taskCount);
+
+  IoHandler& task(size_t index);
+  void finish(size_t index);
+
+private:
+  class TaskIoHandler : public IoHandler {
+  public:
+    TaskIoHandler(OrderedIoHandler& owner, size_t index);
+    void write(const std::string& text) override;
+    std::string input() override;
+
+  private:
+    OrderedIoHandler& owner_;
+    size_t index_;
+  };
+
+  struct TaskOutput {
+    std::unique_ptr<TaskIoHandler> handler;
+    std::vector<std::string> lines;
+    bool finished;
+  };
+
+  void write(size_t index, const std::string& text);
+  std::string input();
+
+  IoHandler& output_;
+  std::mutex mutex_;
+  std::vector<TaskOutput> tasks_;
+  size_t nextTask_;
+};
+
+#endif
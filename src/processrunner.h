@@ -0,0 +1,29 @@
+#ifndef PROCESSRUNNER_H
+#define PROCESSRUNNER_H
+#include <string>
+#include <vector>
+
+class IoHandler;
+
+struct ProcessResult {
+  int exitCode;
+  double milliseconds;
+};
+
+// Starts build tools without going through a shell and forwards everything they print, line by line.
+class ProcessRunner {
+public:
+  ProcessRunner(IoHandler& output);
+
+  // The program is looked up in PATH, exitCode is 128 + the signal number when it was killed.
+  // Variables in environment are given as NAME=value and replace the ones cmakegen was started with.
+  ProcessResult run(const std::vector<std::string>& arguments, const std::vector<std::string>& environment = {});
+
+  // Parallel compile jobs the machine can take: one per core, but no more than fit in the available memory.
+  static unsigned int buildJobs();
+
+private:
+  IoHandler& output_;
+};
+
+#endif
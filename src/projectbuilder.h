@@ -1,10 +1,24 @@
 #ifndef PROJECT_BUILDER_H
 #define PROJECT_BUILDER_H
 #include <functional>
+#include <memory>
 #include <vector>
 #include <string>
+#include <string_view>
+
+#include "analysis/precompiledheaders.h"
+#include "analysis/projectparts.h"
+#include "analysis/testtargets.h"
+#include "analysis/unitybuild.h"
+#include "cmake/buildtools.h"
+#include "cmake/releaseprofile.h"
+#include "file_utils/batchio.h"
+#include "file_utils/fileutils.h"
+#include "file_utils/patharena.h"
+#include "processrunner.h"
 
 namespace file_utils {
+class Directory;
 class IgnoreFile;
 }
 
@@ -12,23 +26,111 @@ namespace cmake {
 class CmakeFunction;
 }
 
+struct ProjectBuilderOptions {
+  // make, ninja or ninja-direct, which builds from a build.ninja written without cmake
+  std::string buildSystem = "make";
+  std::string cppVersion = "cxx_std_11";
+  bool stream = false;
+  bool verbose = false;
+  bool dryRun = false;
+  bool buildReport = false;
+  unsigned int jobs = 0;
+  // debug, release, relwithdebinfo, minsizerel, asan, ubsan or tsan, built at the same time in _build/<name>
+  std::vector<std::string> configurations;
+  // rewrites the precompiled headers section of every target from what its sources include
+  bool precompileHeaders = false;
+  analysis::PrecompiledHeaderOptions precompiledHeaders;
+  // rewrites the unity build section of every target, sources grouped by size
+  bool unityBuild = false;
+  analysis::UnityBuildOptions unity;
+  // rewrites the release profile section of every target, set by --profile and --march
+  bool releaseProfile = false;
+  cmake::ReleaseProfile profile;
+  // looks for a compiler launcher and a faster linker again and rewrites the top level build tools section
+  bool buildTools = false;
+  // splits projects with more source bytes than the budget again, otherwise the parts written before are kept
+  bool splitProjects = false;
+  analysis::ProjectPartOptions parts;
+  // finds the tests again and rewrites the tests sections, otherwise the tests written before are kept
+  bool registerTests = false;
+  analysis::TestOptions tests;
+};
+
+// A cmake build directory and how it is configured, the default build has no name and lives in _build.
+struct BuildConfiguration {
+  std::string name;
+  std::string directory;
+  std::vector<std::string> cmakeArguments;
+};
+
+// The sections of one project's CMakeLists.txt that -b rewrites, the ones left null aren't touched.
+struct ProjectSections {
+  const std::vector<analysis::PrecompiledHeader>* precompiledHeaders = nullptr;
+  const std::vector<analysis::UnityGroup>* unityGroups = nullptr;
+  const cmake::ReleaseProfile* releaseProfile = nullptr;
+  // the parts written before are kept when these are left null
+  const std::vector<analysis::ProjectPart>* parts = nullptr;
+  // the tests written before are kept when these are left null
+  const std::vector<analysis::TestTarget>* tests = nullptr;
+  // only used for the top level CMakeLists.txt
+  const cmake::BuildTools* buildTools = nullptr;
+  // whether a testing section turns testing on, used for the top level CMakeLists.txt or, without one, the projects with tests
+  const bool* testing = nullptr;
+};
+
+// Files to add to and remove from a set() function, paths are relative to the project.
+struct FileSetDiff {
+  bool empty() const;
+
+  std::vector<std::string> added;
+  std::vector<std::string> removed;
+};
+
 class IoHandler;
 class ProjectBuilder {
 public:
-  ProjectBuilder(const std::string& buildSystem, const file_utils::IgnoreFile& ignoreFile, IoHandler& ioHandler);
-  void run();
+  ProjectBuilder(
+    const ProjectBuilderOptions& options,
+    const file_utils::IgnoreFile& ignoreFile,
+    const file_utils::WalkOptions& walkOptions,
+    IoHandler& ioHandler
+  );
+  int run();
 private:
-  void update();
-  void replaceSetFunction(
-    const std::function<void(const std::vector<std::string>&)> replaceFileFunction,
+  bool update();
+  bool updateProject(
+    const file_utils::Directory& cmakeDirectory,
+    const file_utils::FileContents& contents,
+    const ProjectSections& sections,
+    IoHandler& output
+  );
+  FileSetDiff replaceSetFunction(
+    const std::function<void(const std::vector<std::string_view>&)> replaceFileFunction,
     const cmake::CmakeFunction* function,
-    const std::vector<std::string>& files
+    const std::vector<std::string_view>& files,
+    std::string_view projectPath
+  );
+  int build(bool cmakeFilesChanged);
+  int buildConfigurations(const std::vector<BuildConfiguration>& configurations, bool ninja, bool cmakeFilesChanged, unsigned int jobs);
+  ProcessResult buildConfiguration(
+    const BuildConfiguration& configuration,
+    bool ninja,
+    bool cmakeFilesChanged,
+    const std::vector<std::string>& jobArguments,
+    const std::vector<std::string>& environment,
+    unsigned int jobs,
+    IoHandler& output
   );
-  void build();
+  int configure(ProcessRunner& runner, const BuildConfiguration& configuration, bool ninja, bool cmakeFilesChanged, IoHandler& output);
+  int writeDirectNinjaFile();
+  bool isConfigured(const std::string& directory, bool ninja) const;
 
-  std::string buildSystem_;
+  ProjectBuilderOptions options_;
   const file_utils::IgnoreFile& ignoreFile_;
+  file_utils::WalkOptions walkOptions_;
   IoHandler& ioHandler_;
+  file_utils::PathArena paths_;
+  std::unique_ptr<file_utils::BatchIo> io_;
 };
 
 #endif
\ No newline at end of file
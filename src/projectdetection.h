@@ -0,0 +1,36 @@
+#ifndef PROJECTDETECTION_H
+#define PROJECTDETECTION_H
+#include <vector>
+
+#include "file_utils/fileutils.h"
+
+class ThreadPool;
+
+namespace file_utils {
+class Directory;
+}
+
+struct ProjectDetectionOptions {
+  // how much of every source is searched for main(), nearly all sources fit whole
+  unsigned long long prefixBytes = 64 * 1024;
+};
+
+// The directories -g proposes as projects, judged by the layout of the tree alone: the root, so
+// every project can be added from it, directories with at least two of src, include and test
+// style subdirectories, the top of trees holding only headers and otherwise the highest
+// directories with files of their own. Everything below a proposed directory other than the root
+// belongs to its project.
+std::vector<const file_utils::Directory*> proposeProjects(const file_utils::Directory& root);
+
+// Whether each project is an executable, by the name of its sources or a definition of main()
+// in the first prefixBytes of them, sources below a test directory aside. The sources of all
+// projects are read in batches and searched in parallel.
+std::vector<char> detectExecutables(
+  const std::vector<const file_utils::Directory*>& projects,
+  const std::vector<file_utils::DirectoryFiles>& files,
+  const ProjectDetectionOptions& options,
+  file_utils::BatchIo& io,
+  const ThreadPool& pool
+);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef PROJECTMODEL_H
+#define PROJECTMODEL_H
+#include <string>
+#include <vector>
+
+#include "file_utils/batchio.h"
+
+namespace file_utils {
+class Directory;
+class PathArena;
+}
+
+class IoHandler;
+
+// A target an earlier run split off a project's own and wrote into a section of its CMakeLists.txt,
+// an object library part or a test executable. Both are compiled with the flags of the project.
+struct SplitTarget {
+  std::string name;
+  std::vector<std::string> sourceFiles;
+  // what a test links besides the project, GTest::GTest, GTest::Main, Catch2::Catch2 or Catch2::Catch2WithMain
+  std::vector<std::string> linkLibraries;
+};
+
+// One project as cmakegen sees it: the files the walk found for it and the target settings from its
+// CMakeLists.txt. Paths are relative to the root as "./dir/file", the settings are kept as written.
+// PUBLIC and INTERFACE include directories and definitions are also in the interface lists, which
+// the projects linking the target get as well, include directories made absolute.
+struct ProjectModel {
+  std::string path;
+  std::string target;
+  bool isLibrary = false;
+  std::string standard;
+  std::vector<std::string> compileOptions;
+  std::vector<std::string> definitions;
+  std::vector<std::string> includeDirectories;
+  std::vector<std::string> interfaceDefinitions;
+  std::vector<std::string> interfaceIncludeDirectories;
+  std::vector<std::string> linkLibraries;
+  std::vector<std::string> includeFiles;
+  std::vector<std::string> sourceFiles;
+  // the parts and tests of the target, their sources aren't in sourceFiles
+  std::vector<SplitTarget> parts;
+  std::vector<SplitTarget> tests;
+};
+
+// Reads and parses the CMakeLists.txt of every project below root in one batch, the models come back in depth first order.
+// Projects without a target get the directory name as target and the default standard.
+std::vector<ProjectModel> loadProjectModels(
+  const file_utils::Directory& root,
+  const file_utils::PathArena& paths,
+  file_utils::BatchIo& io,
+  const std::string& defaultStandard,
+  IoHandler& output
+);
+
+// The flags cmake would pass when compiling a source file of the project with a GNU or Clang compiler.
+// Include directories become absolute, values cmake would have to evaluate first are left out.
+std::vector<std::string> compileFlags(const ProjectModel& project, const file_utils::PathArena& paths);
+
+// $CXX when it is set, c++ otherwise.
+std::string cxxCompiler();
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs independent tasks on a fixed number of threads, workers pull the next task index from a shared counter
+// so long tasks don't hold up the rest of a batch.
+class ThreadPool {
+public:
+  explicit ThreadPool(unsigned int jobs) : jobs_(jobs ? jobs : defaultJobs()) {
+  }
+
+  static unsigned int defaultJobs() {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  unsigned int jobs() const {
+    return jobs_;
+  }
+
+  // Calls task(index) once for every index below count and returns when all calls are done,
+  // the first exception thrown by a task is rethrown here.
+  template<class Task>
+  void forEach(size_t count, Task&& task) const {
+    const auto threadCount = static_cast<unsigned int>(std::min<size_t>(jobs_, count));
+    if (threadCount <= 1) {
+      for (size_t i = 0; i < count; i++) {
+        task(i);
+      }
+      return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto worker = [&]() {
+      for (size_t i = next++; i < count; i = next++) {
+        try {
+          task(i);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(errorMutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+          next = count;
+        }
+      }
+    };
+
+    std::vector<std::thread> threads = {};
+    for (unsigned int i = 1; i < threadCount; i++) {
+      threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+private:
+  unsigned int jobs_;
+};
+
+#endif